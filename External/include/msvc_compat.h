@@ -0,0 +1,18 @@
+#pragma once
+
+// Shims for the MSVC specific extensions used by the external libraries,
+// force included by the CMake build when compiling with GCC or Clang
+
+#include <cmath>
+
+#ifndef _NODISCARD
+#define _NODISCARD [[nodiscard]]
+#endif
+
+#ifndef __assume
+#define __assume(cond) do { if (!(cond)) __builtin_unreachable(); } while (0)
+#endif
+
+#ifndef _ITERATOR_DEBUG_LEVEL
+#define _ITERATOR_DEBUG_LEVEL 0
+#endif
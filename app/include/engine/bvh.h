@@ -0,0 +1,89 @@
+#pragma once
+
+#include "renderer/frustum.h"
+
+#include "SudoMaths/vector3.h"
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Index used for the missing nodes : the parent of the root, the children of the leaves
+#define BVH_NULL_NODE UINT32_MAX
+
+// Leaves are fattened by this fraction of their size, so that objects moving a little don't change the tree
+#define BVH_LEAF_MARGIN .1f
+
+// Bounding volume hierarchy over the boxes of objects, identified by their index. It's built top-down once,
+// then kept up to date as the objects move : leaves are refitted while their objects stay around the same place,
+// and reinserted where they fit best once they moved away
+class Bvh
+{
+private:
+	struct Node
+	{
+		Vector3 Min;
+		Vector3 Max;
+
+		uint32_t Parent;
+		uint32_t Left;
+		uint32_t Right;
+		// Object of the leaves, BVH_NULL_NODE for the inner nodes
+		uint32_t Object;
+	};
+
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_FreeNodes;
+	// Leaf of each object
+	std::vector<uint32_t> m_Leaves;
+	uint32_t m_Root;
+
+	uint32_t AllocateNode();
+	void FreeNode(const uint32_t node);
+
+	uint32_t BuildRange(uint32_t* const objects, const uint32_t nbrObjects,
+		const std::vector<Vector3>& mins, const std::vector<Vector3>& maxs, const uint32_t parent);
+
+	void InsertLeaf(const uint32_t leaf);
+	void RemoveLeaf(const uint32_t leaf);
+	void RefitAncestors(uint32_t node);
+
+	void SetFatBox(Node& leaf, const Vector3& min, const Vector3& max) const;
+
+public:
+	Bvh();
+
+	/// <summary>
+	/// Builds the tree from scratch by splitting the objects along the longest axis of their centers
+	/// </summary>
+	/// <param name="mins">Minimum corner of the box of each object, in world space</param>
+	/// <param name="maxs">Maximum corner of the box of each object, in world space</param>
+	void Build(const std::vector<Vector3>& mins, const std::vector<Vector3>& maxs);
+
+	/// <summary>
+	/// Updates the box of an object, the tree only changes when it's out of the fattened box of its leaf
+	/// </summary>
+	/// <param name="object">Index of the object</param>
+	/// <param name="min">Minimum corner of its new box</param>
+	/// <param name="max">Maximum corner of its new box</param>
+	void Update(const uint32_t object, const Vector3& min, const Vector3& max);
+
+	/// <summary>
+	/// Finds the objects whose box is in the frustum. Subtrees entirely inside of it aren't tested any further
+	/// </summary>
+	/// <param name="frustum">Frustum to test the boxes against</param>
+	/// <param name="inside">Objects whose box is entirely inside of the frustum, appended</param>
+	/// <param name="intersecting">Objects whose box crosses one of the planes, appended</param>
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& inside, std::vector<uint32_t>& intersecting) const;
+
+	/// <summary>
+	/// Finds the objects whose box is hit by a ray
+	/// </summary>
+	/// <param name="origin">Origin of the ray</param>
+	/// <param name="direction">Direction of the ray</param>
+	/// <param name="hits">Distance at which the ray enters the box of each object hit, and the object, sorted by distance</param>
+	void QueryRay(const Vector3& origin, const Vector3& direction, std::vector<std::pair<float, uint32_t>>& hits) const;
+
+	uint32_t GetNbrNodes() const;
+	uint32_t GetDepth() const;
+};
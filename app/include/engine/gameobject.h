@@ -1,19 +1,47 @@
 #pragma once
 
 #include "renderer/material.h"
-#include "renderer/vertex.h"
+#include "renderer/Vertex.h"
+#include "renderer/frustum.h"
 
 #include "SudoMaths/vector3.h"
 #include "SudoMaths/matrix4x4.h"
 
+#include <memory>
+#include <span>
 #include <vector>
 
 class Renderer;
 
+// Scaling of the outline drawn around the outlined objects
+#define OUTLINE_SCALING 1.05f
+
+// Simplified version of a model, its indices refer to the vertices of the full model
+struct Lod
+{
+	std::vector<uint32_t> indices;
+	// Largest distance to the surface of the full model, in model space
+	float error;
+};
+
+// Geometry of a model, shared by the objects copied from the one that loaded it
+struct Mesh
+{
+	// Unique vertices of the model, and its levels of detail from the full model : 3 indices per triangle
+	std::vector<Vertex> vertices;
+	std::vector<Lod> lods;
+
+	// Bounding box and sphere of the model, in model space
+	Bounds bounds;
+};
+
 class GameObject
 {
 private:
-	std::vector<Vertex> m_Vertices;
+	std::shared_ptr<const Mesh> m_Mesh;
+
+	uint32_t SelectLod(const Renderer& renderer, const Matrix4x4& model, const float screenHeight,
+		const float maxPixelError) const;
 
 public:
 	Vector3 Position;
@@ -25,17 +53,80 @@ public:
 
 	bool Hidden;
 	bool Outlined;
+	// Whether the object is drawn to the occlusion buffer, to skip the objects behind it
+	bool Occluder;
 
 	GameObject();
 	GameObject(const Vector3& position, const Vector3& rotation, const Vector3& scaling);
 	GameObject(const Vector3& position, const Vector3& rotation, const Vector3& scaling,
 		const char* const modelName, const Material& material, const size_t textureId);
 
+	/// <summary>
+	/// Loads the mesh of the object from an OBJ file, or shares it with the objects that already loaded that file
+	/// </summary>
+	/// <param name="name">Path of the file</param>
 	void LoadModel(const char* const name);
 
+	/// <summary>
+	/// Creates the mesh of the object from indexed triangles, optimized and simplified like the loaded models
+	/// </summary>
+	/// <param name="name">Name of the mesh, for the logs</param>
+	/// <param name="vertices">Vertices of the mesh</param>
+	/// <param name="indices">Indices of the vertices of each triangle, 3 per triangle</param>
+	void CreateMesh(const char* const name, std::vector<Vertex> vertices, std::vector<uint32_t> indices);
+
 	void CalculateModelMatrix(Matrix4x4& model) const;
 
+	/// <summary>
+	/// Tests whether the object can be drawn by the same instanced draw as another one
+	/// </summary>
+	/// <param name="other">Other object</param>
+	/// <returns>True if both have the same mesh, texture and material, and neither is outlined</returns>
+	bool CanShareDraw(const GameObject& other) const;
+
+	/// <summary>
+	/// Computes the world space box around the transformed bounding box of the mesh, and of its outline when outlined
+	/// </summary>
+	/// <param name="min">Minimum corner of the box</param>
+	/// <param name="max">Maximum corner of the box</param>
+	void CalculateWorldBounds(Vector3& min, Vector3& max) const;
+
+	/// <summary>
+	/// Tests the bounds of the object, and of its outline when outlined, against the frustum of the camera
+	/// </summary>
+	/// <param name="renderer">Renderer whose camera is tested against</param>
+	/// <returns>False if nothing of the object can be seen</returns>
+	bool IsVisible(const Renderer& renderer) const;
+
+	/// <summary>
+	/// Tests the bounds of the object, and of its outline when outlined, against the occluders drawn this frame
+	/// </summary>
+	/// <param name="renderer">Renderer whose occlusion buffer is tested against</param>
+	/// <returns>True if the object is entirely behind the occluders</returns>
+	bool IsOccluded(const Renderer& renderer) const;
+
+	/// <summary>
+	/// Intersects a ray with the triangles of the full model
+	/// </summary>
+	/// <param name="origin">Origin of the ray, in world space</param>
+	/// <param name="direction">Direction of the ray, in world space</param>
+	/// <param name="distance">Distance along the direction of the closest hit, only written when there is one</param>
+	/// <returns>Whether the ray hits the object</returns>
+	bool Raycast(const Vector3& origin, const Vector3& direction, float& distance) const;
+
 	void Render(Renderer& renderer) const;
 	void RenderOutlined(Renderer& renderer) const;
-};
 
+	/// <summary>
+	/// Draws objects that can share their draw with instanced draws, one per level of detail they use
+	/// </summary>
+	/// <param name="renderer">Renderer to draw with</param>
+	/// <param name="objects">Objects to draw, the first one's mesh, texture and material are used for all of them</param>
+	static void RenderInstanced(Renderer& renderer, const std::span<const GameObject* const> objects);
+
+	/// <summary>
+	/// Draws the depth of the object to the occlusion buffer, with the coarsest level of detail that is still accurate there
+	/// </summary>
+	/// <param name="renderer">Renderer whose occlusion buffer is drawn to</param>
+	void RenderOccluder(Renderer& renderer) const;
+};
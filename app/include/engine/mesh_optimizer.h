@@ -0,0 +1,50 @@
+#pragma once
+
+#include "renderer/Vertex.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Size of the FIFO cache the ACMR is measured with, a common size for post-transform caches
+#define ACMR_CACHE_SIZE 16
+
+/// <summary>
+/// Reorders the triangles so that consecutive triangles share vertices, using Tom Forsyth's
+/// linear-speed vertex cache optimisation
+/// </summary>
+/// <param name="indices">Indices of the triangles, reordered in place</param>
+/// <param name="nbrVertices">Number of vertices the indices refer to</param>
+void OptimizeVertexCache(std::vector<uint32_t>& indices, const uint32_t nbrVertices);
+
+/// <summary>
+/// Splits the triangles into clusters which keep most of the vertex cache locality, and sorts them
+/// so that the ones facing outwards, likely to hide the others, are drawn first
+/// </summary>
+/// <param name="indices">Indices of the triangles, optimized for the vertex cache, reordered in place</param>
+/// <param name="vertices">Vertices the indices refer to</param>
+/// <param name="threshold">How much the ACMR is allowed to grow to create more clusters, 1.05 allows 5%</param>
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const float threshold);
+
+/// <summary>
+/// Reorders the vertices in the order the triangles first reference them, unreferenced vertices are removed
+/// </summary>
+/// <param name="vertices">Vertices, reordered in place</param>
+/// <param name="indices">Indices of the triangles, remapped to the new order</param>
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+/// <summary>
+/// Computes the average number of vertices transformed per triangle with a FIFO post-transform cache
+/// </summary>
+/// <param name="indices">Indices of the triangles</param>
+/// <param name="nbrVertices">Number of vertices the indices refer to</param>
+/// <returns>Average cache miss ratio, between 0.5 (at best) and 3</returns>
+float ComputeAcmr(const std::vector<uint32_t>& indices, const uint32_t nbrVertices);
+
+/// <summary>
+/// Rasterizes the front faces in order from 26 directions around the mesh, and compares the number of fragments
+/// passing the depth test with the number of pixels covered
+/// </summary>
+/// <param name="indices">Indices of the triangles</param>
+/// <param name="vertices">Vertices the indices refer to</param>
+/// <returns>Overdraw ratio, 1 when every pixel is only shaded once</returns>
+float ComputeOverdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "renderer/Vertex.h"
+
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// Simplifies a mesh by collapsing its edges in order of their quadric error. Vertices are only moved onto
+/// their neighbors, so the simplified triangles keep referencing the same vertices. Borders are only collapsed
+/// along themselves, and uv seams along themselves on both of their sides, so that they stay closed
+/// </summary>
+/// <param name="vertices">Vertices of the mesh</param>
+/// <param name="indices">Indices of the triangles to simplify</param>
+/// <param name="targetNbrIndices">Number of indices to reduce the mesh to, it can stop before</param>
+/// <param name="targetError">Largest distance a collapse can move the surface by, it stops before exceeding it</param>
+/// <param name="result">Indices of the simplified triangles</param>
+/// <returns>Largest distance between the simplified surface and the one it was simplified from</returns>
+float SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const uint32_t targetNbrIndices, const float targetError, std::vector<uint32_t>& result);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SudoMaths/vector4.h"
+#include "renderer/fragment_pipeline.h"
 
 enum class BlendEquation
 {
@@ -49,4 +50,10 @@ public:
 	/// <param name="scrColor">New color that should be applied</param>
 	/// <returns>The blend between dstColor and scrColor</returns>
 	Vector4 ComputeBlending(const Vector4& dstColor, const Vector4& scrColor);
+
+	/// <summary>
+	/// Gets the fragment pipeline matching the blend factors and equation
+	/// </summary>
+	/// <returns>Blend mode, NONE when blending is disabled</returns>
+	BlendMode GetMode() const;
 };
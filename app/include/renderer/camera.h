@@ -2,6 +2,8 @@
 
 #include "SudoMaths/vector3.h"
 
+#include "renderer/frustum.h"
+
 class Renderer;
 
 class Camera
@@ -9,8 +11,12 @@ class Camera
 private:
 	Renderer& m_Renderer;
 
+	// Planes of the view volume, kept up to date with the matrices
+	Frustum m_Frustum;
+
 	void SendViewMatrix();
 	void SendProjectionMatrix();
+	void UpdateFrustum();
 
 public:
 	Vector3 Position;
@@ -26,4 +32,15 @@ public:
 		const float fov, const float zDepthNear, const float zDepthFar, Renderer& renderer);
 
 	void Update();
+
+	const Frustum& GetFrustum() const;
+
+	/// <summary>
+	/// Computes the ray going from the camera through a pixel of the viewport
+	/// </summary>
+	/// <param name="x">Horizontal position in the framebuffer, in pixels</param>
+	/// <param name="y">Vertical position in the framebuffer, in pixels from the first row</param>
+	/// <param name="origin">Origin of the ray, the position of the camera</param>
+	/// <param name="direction">Normalized direction of the ray</param>
+	void ScreenToRay(const float x, const float y, Vector3& origin, Vector3& direction) const;
 };
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+
+#include "SudoMaths/vector4.h"
+
+// Formats the framebuffer stores its pixels in, picked when the renderer is created. Fragments are always shaded
+// with floats, and only converted when they're written, or read back for blending and the resolve
+
+enum class ColorFormat
+{
+	// 4 floats, 16 bytes per pixel
+	RGBA32F,
+	// 4 half floats, 8 bytes per pixel
+	RGBA16F,
+	// 4 normalized bytes, 4 bytes per pixel
+	RGBA8
+};
+
+enum class DepthFormat
+{
+	// Float depth, and the stencil in its own 8 bits plane : 5 bytes per pixel
+	D32F,
+	// 24 bits normalized depth, with the stencil in the low byte of the same word : 4 bytes per pixel
+	D24S8,
+	// 16 bits normalized depth, and the stencil in its own 8 bits plane : 3 bytes per pixel
+	D16
+};
+
+enum class FramebufferLayout
+{
+	// Rows of pixels, one after the other
+	LINEAR,
+	// 8x8 pixels micro-tiles, in rows, with their pixels in Morton order : x and y bits interleaved, x first.
+	// A triangle touches fewer cache lines and pages, and each group of SIMD lanes is contiguous
+	TILED
+};
+
+// Bits of the normalized depth formats
+#define DEPTH16_BITS 16
+#define DEPTH24_BITS 24
+
+/// <summary>
+/// Gets the size of a pixel of the color buffer
+/// </summary>
+/// <param name="format">Color format</param>
+/// <returns>Size, in bytes</returns>
+uint32_t GetColorFormatSize(const ColorFormat format);
+
+/// <summary>
+/// Gets the size of a pixel of the depth and stencil buffers
+/// </summary>
+/// <param name="format">Depth format</param>
+/// <returns>Size, in bytes</returns>
+uint32_t GetDepthFormatSize(const DepthFormat format);
+
+/// <summary>
+/// Gets the number of pixels the buffers store, tiled buffers are padded to whole micro-tiles
+/// </summary>
+/// <param name="width">Framebuffer width</param>
+/// <param name="height">Framebuffer height</param>
+/// <param name="layout">Layout of the pixels</param>
+/// <returns>Number of pixels</returns>
+uint32_t GetFramebufferSize(const uint32_t width, const uint32_t height, const FramebufferLayout layout);
+
+const char* GetColorFormatName(const ColorFormat format);
+const char* GetDepthFormatName(const DepthFormat format);
+const char* GetFramebufferLayoutName(const FramebufferLayout layout);
+
+inline float ClampUnorm(const float value)
+{
+	return value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+}
+
+// Red in the lowest byte, so that the buffer is laid out as RGBA in memory
+inline uint32_t PackRgba8(const Vector4& color)
+{
+	return static_cast<uint32_t>(ClampUnorm(color.x) * 255.f + .5f) |
+		static_cast<uint32_t>(ClampUnorm(color.y) * 255.f + .5f) << 8 |
+		static_cast<uint32_t>(ClampUnorm(color.z) * 255.f + .5f) << 16 |
+		static_cast<uint32_t>(ClampUnorm(color.w) * 255.f + .5f) << 24;
+}
+
+inline Vector4 UnpackRgba8(const uint32_t color)
+{
+	return Vector4(
+		(color & 0xff) / 255.f,
+		(color >> 8 & 0xff) / 255.f,
+		(color >> 16 & 0xff) / 255.f,
+		(color >> 24) / 255.f
+	);
+}
+
+// IEEE 754 half float, rounded to the nearest even value
+inline uint16_t FloatToHalf(const float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const uint32_t sign = bits >> 16 & 0x8000;
+	const uint32_t absolute = bits & 0x7fffffff;
+
+	// NaN stays NaN, infinity and values too large for a half become infinity
+	if (absolute > 0x7f800000)
+		return static_cast<uint16_t>(sign | 0x7e00);
+	if (absolute >= 0x477ff000)
+		return static_cast<uint16_t>(sign | 0x7c00);
+
+	// Denormals : the implicit bit is shifted in with the mantissa
+	if (absolute < 0x38800000)
+	{
+		const int32_t shift = 113 - static_cast<int32_t>(absolute >> 23);
+		if (shift > 11)
+			return static_cast<uint16_t>(sign);
+
+		const uint32_t mantissa = (absolute & 0x7fffff) | 0x800000;
+		const uint32_t half = mantissa >> (shift + 13);
+		const uint32_t rest = mantissa & ((1u << (shift + 13)) - 1);
+		const uint32_t middle = 1u << (shift + 12);
+
+		return static_cast<uint16_t>(sign | (half + (rest > middle || (rest == middle && (half & 1) != 0))));
+	}
+
+	// Rebias the exponent, a carry out of the mantissa when rounding goes to the next exponent
+	const uint32_t half = (absolute - 0x38000000) >> 13;
+	const uint32_t rest = absolute & 0x1fff;
+
+	return static_cast<uint16_t>(sign | (half + (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))));
+}
+
+inline float HalfToFloat(const uint16_t value)
+{
+	const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	const uint32_t exponent = value >> 10 & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | mantissa << 13;
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | (exponent + 112) << 23 | mantissa << 13;
+	}
+	else if (mantissa == 0)
+	{
+		bits = sign;
+	}
+	else
+	{
+		// Denormal, normalized for the float
+		uint32_t shift = 0;
+		while ((mantissa & 0x400) == 0)
+		{
+			mantissa <<= 1;
+			shift++;
+		}
+
+		bits = sign | (113 - shift) << 23 | (mantissa & 0x3ff) << 13;
+	}
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+inline uint64_t PackRgba16F(const Vector4& color)
+{
+	return static_cast<uint64_t>(FloatToHalf(color.x)) |
+		static_cast<uint64_t>(FloatToHalf(color.y)) << 16 |
+		static_cast<uint64_t>(FloatToHalf(color.z)) << 32 |
+		static_cast<uint64_t>(FloatToHalf(color.w)) << 48;
+}
+
+inline Vector4 UnpackRgba16F(const uint64_t color)
+{
+	return Vector4(
+		HalfToFloat(static_cast<uint16_t>(color)),
+		HalfToFloat(static_cast<uint16_t>(color >> 16)),
+		HalfToFloat(static_cast<uint16_t>(color >> 32)),
+		HalfToFloat(static_cast<uint16_t>(color >> 48))
+	);
+}
+
+// Normalized depth of a fragment : the range is split in 2^bits steps, and 1 falls in the last one.
+// Scaling by a power of 2 is exact, so the vectorized fragment paths get the same values
+inline uint32_t QuantizeDepth(const float depth, const uint32_t bits)
+{
+	const uint32_t max = (1u << bits) - 1;
+	const uint32_t value = static_cast<uint32_t>(ClampUnorm(depth) * static_cast<float>(1u << bits));
+
+	return value < max ? value : max;
+}
+
+inline float DequantizeDepth(const uint32_t depth, const uint32_t bits)
+{
+	return (depth + .5f) / static_cast<float>(1u << bits);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Render state the fragment pipelines are specialized on, each draw picks the pipeline matching its state once
+// so that the pixel loop doesn't branch on it
+
+enum class TextureMode
+{
+	NONE,
+	NEAREST,
+	LINEAR,
+	COUNT
+};
+
+// Blend factors and equations that have their own pipeline, any other combination goes through Blending
+enum class BlendMode
+{
+	NONE,
+	// SRC_ALPHA, ONE_MINUS_SRC_ALPHA, ADD
+	ALPHA,
+	// ONE, ONE, ADD
+	ADDITIVE,
+	// DST_COLOR, ZERO, ADD
+	MULTIPLY,
+	GENERIC,
+	COUNT
+};
+
+// The stencil state itself is read for each fragment, only whether it's tested at all is specialized on
+enum class StencilMode
+{
+	NONE,
+	TEST,
+	COUNT
+};
+
+enum class LightMode
+{
+	NONE,
+	ONE,
+	MANY,
+	COUNT
+};
+
+#define NBR_FRAGMENT_PIPELINES (static_cast<uint32_t>(TextureMode::COUNT) * static_cast<uint32_t>(BlendMode::COUNT) * \
+	static_cast<uint32_t>(StencilMode::COUNT) * static_cast<uint32_t>(LightMode::COUNT))
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "SudoMaths/vector3.h"
+#include "SudoMaths/vector4.h"
+#include "SudoMaths/matrix4x4.h"
+
+#define NBR_FRUSTUM_PLANES 6
+
+// Bounding volumes of a model, in model space
+struct Bounds
+{
+	Vector3 Min;
+	Vector3 Max;
+
+	Vector3 Center;
+	float Radius;
+};
+
+// Where a volume is relatively to a frustum
+enum class Containment
+{
+	OUTSIDE,
+	INTERSECTS,
+	INSIDE
+};
+
+class Frustum
+{
+public:
+	// Left, right, bottom, top, near and far planes in world space, normals pointing inwards : a point
+	// is inside of a plane when dot(plane.xyz, point) + plane.w >= 0
+	Vector4 Planes[NBR_FRUSTUM_PLANES];
+
+	/// <summary>
+	/// Extracts the planes of the clip volume from a view-projection matrix (Gribb and Hartmann)
+	/// </summary>
+	/// <param name="viewProjection">Projection matrix multiplied by the view matrix</param>
+	void Extract(const Matrix4x4& viewProjection);
+
+	/// <summary>
+	/// Tests a sphere against the planes
+	/// </summary>
+	/// <param name="center">Center of the sphere, in world space</param>
+	/// <param name="radius">Radius of the sphere</param>
+	/// <param name="inside">Set to whether the sphere is entirely inside of the frustum</param>
+	/// <returns>False if the sphere is entirely outside of one of the planes</returns>
+	bool IntersectsSphere(const Vector3& center, const float radius, bool& inside) const;
+
+	/// <summary>
+	/// Tests an axis aligned box against the planes, only using its corner furthest along each plane's normal
+	/// </summary>
+	/// <param name="center">Center of the box, in world space</param>
+	/// <param name="extents">Half the size of the box</param>
+	/// <returns>False if the box is entirely outside of one of the planes</returns>
+	bool IntersectsBox(const Vector3& center, const Vector3& extents) const;
+
+	/// <summary>
+	/// Tests an axis aligned box against the planes, also telling whether it's entirely inside of all of them
+	/// </summary>
+	/// <param name="center">Center of the box, in world space</param>
+	/// <param name="extents">Half the size of the box</param>
+	/// <returns>Whether the box is outside, crossing one of the planes, or inside of the frustum</returns>
+	Containment ClassifyBox(const Vector3& center, const Vector3& extents) const;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "renderer/Vertex.h"
+#include "renderer/frustum.h"
+
+#include "SudoMaths/matrix4x4.h"
+#include "SudoMaths/vector4.h"
+
+// Size of the occlusion buffer, the width is a multiple of the 4 pixels rasterized at once
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+
+// Low resolution depth-only buffer the occluders are rasterized into, which the bounds of the other objects are
+// tested against. Occluders write the farthest depth they have in each pixel, and objects are tested against
+// the pixels around their rectangle too, so an object is never reported as hidden when some part of it could be seen
+class OcclusionBuffer
+{
+private:
+	// Normalized device depth of the closest occluder in each pixel, 1 where there is none
+	std::vector<float> m_Depths;
+	// Clip space positions of the vertices of the occluder being rasterized
+	std::vector<Vector4> m_ClipPositions;
+
+	void DrawTriangle(const Vector4& clip0, const Vector4& clip1, const Vector4& clip2);
+
+public:
+	OcclusionBuffer();
+
+	void Clear();
+
+	/// <summary>
+	/// Rasterizes the depth of triangles, the ones crossing the near plane are skipped
+	/// </summary>
+	/// <param name="vertices">Vertices of the occluder</param>
+	/// <param name="indices">Indices of the vertices of each triangle, 3 per triangle</param>
+	/// <param name="mvp">Model, view and projection matrices multiplied together</param>
+	void DrawOccluder(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Matrix4x4& mvp);
+
+	/// <summary>
+	/// Tests the screen rectangle of a box against the occluders, at the depth of its closest corner
+	/// </summary>
+	/// <param name="bounds">Bounds of the object, in model space</param>
+	/// <param name="mvp">Model, view and projection matrices multiplied together</param>
+	/// <returns>True if the occluders are in front of the whole rectangle</returns>
+	bool IsOccluded(const Bounds& bounds, const Matrix4x4& mvp) const;
+};
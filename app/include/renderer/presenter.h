@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Converts the finished frames to RGBA8 rows on its own thread, while the renderer draws the next frame in another
+// color target. Each color target has its own staging buffer, and frames are converted one at a time in the order
+// they're presented, so the staging buffer of the latest frame is never written while it's read
+class Presenter
+{
+public:
+	// Converts the pixels of a color target to RGBA8 rows in a staging buffer
+	typedef std::function<void(const uint32_t target, uint8_t* const staging)> ConvertFunc;
+
+private:
+	ConvertFunc m_Convert;
+	std::vector<std::vector<uint8_t>> m_Stagings;
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	std::condition_variable m_Done;
+
+	// Target waiting to be converted, and target being converted
+	int32_t m_Queued;
+	int32_t m_Converting;
+	// Target of the latest converted frame, and whether it was acquired since
+	int32_t m_Latest;
+	bool m_HasNewFrame;
+	double m_ConvertTime;
+	bool m_Stopping;
+
+	void PresentLoop();
+
+public:
+	/// <summary>
+	/// Creates the staging buffers and starts the present thread
+	/// </summary>
+	/// <param name="nbrTargets">Number of color targets of the renderer</param>
+	/// <param name="stagingSize">Size of a converted frame, in bytes</param>
+	/// <param name="convert">Conversion of a color target, called on the present thread</param>
+	Presenter(const uint32_t nbrTargets, const size_t stagingSize, const ConvertFunc& convert);
+	~Presenter();
+
+	/// <summary>
+	/// Queues the conversion of a finished color target, after the previous one has started
+	/// </summary>
+	/// <param name="target">Color target holding the frame</param>
+	void Present(const uint32_t target);
+
+	/// <summary>
+	/// Waits until a color target is neither queued nor being converted, before the renderer draws in it again
+	/// </summary>
+	/// <param name="target">Color target</param>
+	void WaitForTarget(const uint32_t target);
+
+	// Waits until every frame presented is converted
+	void WaitForIdle();
+
+	/// <summary>
+	/// Gets the latest converted frame, if it wasn't acquired yet. It stays valid until the next call to Present
+	/// </summary>
+	/// <returns>RGBA8 rows of the frame, nullptr if no frame was converted since the last call</returns>
+	const uint8_t* AcquireLatestFrame();
+
+	/// <summary>
+	/// Gets the latest converted frame, whether it was acquired or not
+	/// </summary>
+	/// <returns>RGBA8 rows of the frame, nullptr if no frame was ever converted</returns>
+	const uint8_t* GetLatestFrame();
+
+	// Time the present thread spent converting the latest frame, in milliseconds
+	double GetConvertTime();
+};
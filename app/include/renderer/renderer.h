@@ -1,15 +1,24 @@
 #pragma once
 
 #include <stdint.h>
+#include <array>
+#include <span>
+#include <utility>
 #include <vector>
 
-#include "renderer/vertex.h"
+#include "renderer/Vertex.h"
 #include "renderer/camera.h"
 #include "renderer/texture.h"
 #include "renderer/material.h"
 #include "renderer/light.h"
 #include "renderer/blending.h"
 #include "renderer/stencil.h"
+#include "renderer/thread_pool.h"
+#include "renderer/presenter.h"
+#include "renderer/simd.h"
+#include "renderer/formats.h"
+#include "renderer/fragment_pipeline.h"
+#include "renderer/occlusion.h"
 #include "engine/gameobject.h"
 
 #include "SudoMaths/matrix4x4.h"
@@ -17,6 +26,68 @@
 
 #define ARR_2D_IDX(x, y) (m_Width * (y) + (x))
 
+// Size in pixels of the screen tiles triangles are binned into
+#define TILE_SIZE 64u
+
+// Size in pixels of the blocks the tiles are split into, which are either skipped, filled or tested pixel per pixel
+#define BLOCK_SIZE 8
+
+// Values interpolated over the triangles, as plane equations : the depth, 1/w, then the varyings divided by w
+// so that they're linear in screen space. There's room for a color, uvs, a normal and a world position
+#define MAX_VARYINGS 16
+#define PLANE_DEPTH 0
+#define PLANE_INV_W 1
+#define PLANE_VARYINGS 2
+#define MAX_PLANES (PLANE_VARYINGS + MAX_VARYINGS)
+
+// Offset of the attributes of the vertices in the varyings
+#define VARYING_COLOR 0
+#define VARYING_UV 4
+// Varyings the vertices carry, the ones after the last attribute are never filled
+#define NBR_VERTEX_VARYINGS (VARYING_UV + 2)
+static_assert(NBR_VERTEX_VARYINGS <= MAX_VARYINGS, "The varyings of the vertices don't fit in MAX_VARYINGS");
+
+// Instanced draws split their instances in this many batches per thread, processed in parallel
+#define INSTANCE_BATCHES_PER_THREAD 4
+
+// Instances processed before their triangles are binned, which bounds the memory used by the batches
+#define MAX_INSTANCES_IN_FLIGHT 1024
+
+// Draws that aren't instanced are split across the batches when each of them gets at least this many triangles
+#define MIN_TRIANGLES_PER_BATCH 1024
+
+// Value of the pixels of the visibility buffer no triangle was drawn on
+#define VISIBILITY_NONE UINT32_MAX
+
+// Wrappers around the intrinsics of an instruction set, defined with the fragment path they're used by
+struct Sse4Lanes;
+struct Avx2Lanes;
+
+enum class RenderMode
+{
+    // Fragments are shaded as soon as they pass the depth test
+    FORWARD,
+    // Triangles are only written to a visibility buffer, visible pixels are shaded once at the end of the frame
+    DEFERRED
+};
+
+// Triangles discarded from the way they face the camera
+enum class CullMode
+{
+    NONE,
+    BACK,
+    FRONT
+};
+
+// Winding of the front facing triangles, once projected on the screen
+enum class FrontFace
+{
+    // Clockwise
+    CW,
+    // Counter-clockwise
+    CCW
+};
+
 class Renderer
 {
 private:
@@ -34,18 +105,224 @@ private:
         {}
     };
 
+    struct TriangleSetup
+    {
+        // Edge functions at the center of pixel (minX, minY), in 28.4 fixed point, and their step for 1 pixel,
+        // the top-left fill rule bias is already subtracted from them
+        int64_t edge[3];
+        int64_t stepX[3];
+        int64_t stepY[3];
+
+        // Bounding box, in pixels, clamped to the viewport
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+
+        // Range of the depth over the triangle, widened by the error of the interpolation
+        float minDepth;
+        float maxDepth;
+
+        // Plane equations : value at the center of pixel (minX, minY) and change for 1 pixel
+        float planeBase[MAX_PLANES];
+        float planeStepX[MAX_PLANES];
+        float planeStepY[MAX_PLANES];
+
+        Vector3 normal;
+
+        // Index in m_DeferredTriangles, written to the visibility buffer
+        uint32_t id;
+    };
+
+    // State of a draw whose shading is deferred to the end of the frame
+    struct DeferredDraw
+    {
+        int32_t texture;
+        uint32_t nbrVaryings;
+        Material material;
+    };
+
+    // Triangle drawn to the visibility buffer, its plane equations are all the resolve needs
+    struct DeferredTriangle
+    {
+        TriangleSetup setup;
+        uint32_t draw;
+    };
+
+    // Triangle coming out of primitive assembly, its indices refer to the vertices of the draw,
+    // followed by the vertices created by clipping
+    struct AssembledTriangle
+    {
+        uint32_t indices[3];
+        uint32_t face;
+    };
+
+    // Vertices going through the vertex stage, and the triangles set up from them. Each thread works on its own batch,
+    // whose buffers are reused by the instances, or the ranges of triangles of a large draw, it processes
+    struct VertexBatch
+    {
+        // Model, view and projection matrices of the instance being processed, and the rotation of its normals
+        Matrix4x4 mvp;
+        Matrix3x3 rotation;
+
+        // Vertices of the instance, when the batch transforms them itself
+        std::vector<Vector4> clipPositions;
+        std::vector<Vector4> screenPositions;
+
+        // Positions the triangles of the batch are assembled from : its own, or the ones of the draw shared by
+        // every batch it was split across. The vertices created by clipping come after the draw's own
+        const Vector4* vertexClipPositions = nullptr;
+        const Vector4* vertexScreenPositions = nullptr;
+        uint32_t nbrVertices = 0;
+        std::vector<Vector4> clippedClipPositions;
+        std::vector<Vector4> clippedScreenPositions;
+        std::vector<Vertex> clippedVertices;
+
+        std::vector<AssembledTriangle> assembledTriangles;
+        std::vector<Vector3> normals;
+
+        // Post-transform cache : stamp of the last instance each vertex was transformed for
+        std::vector<uint32_t> transformStamps;
+        uint32_t transformStamp = 0;
+
+        // Vertices referenced by the instance, in the order they're first referenced, transformed together
+        std::vector<uint32_t> vertexList;
+
+        // Triangles set up from every instance of the batch, in order
+        std::vector<TriangleSetup> setups;
+
+        // Statistics of the batch, added to the ones of the frame when it's submitted
+        uint32_t nbrVerticesTransformed = 0;
+        uint32_t nbrTrianglesCulled = 0;
+        uint32_t nbrTrianglesCulledByFacing = 0;
+        uint32_t nbrTrianglesClipped = 0;
+        double transformTime = 0.0;
+
+        const Vector4& GetClipPosition(const uint32_t index) const
+        {
+            return index < nbrVertices ? vertexClipPositions[index] : clippedClipPositions[index - nbrVertices];
+        }
+
+        const Vector4& GetScreenPosition(const uint32_t index) const
+        {
+            return index < nbrVertices ? vertexScreenPositions[index] : clippedScreenPositions[index - nbrVertices];
+        }
+    };
+
+    struct Tile
+    {
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+
+        // Indices in m_TriangleSetups of the triangles overlapping the tile, in submission order
+        std::vector<uint32_t> triangles;
+
+        // Upper bound of the depth buffer over the tile, computed from the blocks when they've changed
+        float maxDepth;
+        bool maxDepthDirty;
+
+        // Whether the color, and the depth and stencil, of the tile still hold the previous frame : ClearBuffers only
+        // sets these, and the tile is filled with the clear values before anything is drawn on it. ResolveClears only
+        // fills the colors, which are the only pixels read outside of the rasterization
+        bool pendingColorClear;
+        bool pendingDepthClear;
+
+        // Statistics of the current draw, gathered per tile so that threads don't share counters
+        uint64_t nbrPixelsTested;
+        uint64_t nbrPixelsShaded;
+        uint32_t nbrTrianglesRejected;
+        uint32_t nbrBlocksRejected;
+    };
+
+    typedef void (Renderer::*DrawBlockFunc)(const TriangleSetup& setup, Tile& tile,
+        const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3]);
+    typedef bool (Renderer::*FinishFragmentFunc)(const TriangleSetup& setup, const int32_t x, const int32_t y,
+        const float depth, const float varyings[MAX_VARYINGS]);
+    typedef Vector4 (Renderer::*ComputeColorFunc)(const TriangleSetup& setup, const int32_t x, const int32_t y,
+        const float depth, const float varyings[MAX_VARYINGS], const int32_t texture, const Material& material);
+
+    // Fragment functions compiled for a given render state, picked once per draw
+    struct FragmentPipeline
+    {
+        // Indexed by whether the block needs its coverage tested
+        DrawBlockFunc drawBlock[2];
+        FinishFragmentFunc finishFragment;
+        ComputeColorFunc computeColor;
+    };
+
     uint32_t m_Width;
     uint32_t m_Height;
 
     int32_t m_FramebufferScale;
 
+    // Pixel of the framebuffer clicked in its window, until it's retrieved
+    bool m_HasViewportClick;
+    Vector2 m_ViewportClick;
+
     uint32_t m_TextureId;
 
+    // Layout of the pixels, shared by the color, depth, stencil and visibility buffers, and the number of pixels
+    // they store. The tiled micro-tiles are the blocks of the hierarchical depth buffer
+    FramebufferLayout m_Layout;
+    uint32_t m_NbrStoredPixels;
+    // Copy of the tiled color buffer in rows, for the readers that need them
+    std::vector<uint8_t> m_LinearColorBuffer;
+
+    // Color buffer of the target being drawn in, only the one matching the color format is allocated
+    ColorFormat m_ColorFormat;
     Vector4* m_ColorBuffer;
+    uint64_t* m_ColorBuffer16F;
+    uint32_t* m_ColorBuffer8;
+
+    struct ColorTarget
+    {
+        Vector4* color;
+        uint64_t* color16F;
+        uint32_t* color8;
+    };
+
+    // Color targets the frames are drawn in in turn, so that the next frame is drawn while the present thread
+    // converts the previous one. There is no present thread with a single target, frames are read from it instead
+    std::vector<ColorTarget> m_ColorTargets;
+    uint32_t m_ColorTarget;
+    Presenter* m_Presenter;
+
+    // Depth buffer, only the one matching the depth format is allocated. Normalized depths are compared quantized,
+    // the cleared value is the largest one
+    DepthFormat m_DepthFormat;
     float_t* m_DepthBuffer;
+    uint32_t* m_DepthBuffer24;
+    uint16_t* m_DepthBuffer16;
+
+    // Hierarchical depth buffer : upper bound of the depth of each 8x8 block (and of each tile), used to reject
+    // the triangles that can't pass the depth test before visiting their pixels
+    std::vector<float> m_BlockMaxDepths;
+    uint32_t m_NbrBlocksX;
+
+    // Depth of the occluders, drawn before the other objects to skip the ones behind them
+    OcclusionBuffer m_OcclusionBuffer;
+
+    RenderMode m_RenderMode;
+    CullMode m_CullMode;
+    FrontFace m_FrontFace;
+    // Whether the current draw writes to the visibility buffer instead of shading its fragments
+    bool m_DeferredDraw;
+    uint32_t* m_VisibilityBuffer;
+    std::vector<DeferredDraw> m_DeferredDraws;
+    std::vector<DeferredTriangle> m_DeferredTriangles;
 
     Vector4 m_ClearColor;
 
+    // Color of the last clear, in each color format, which the tiles are filled with
+    struct ClearValues
+    {
+        Vector4 color;
+        uint64_t color16F;
+        uint32_t color8;
+    } m_TileClearValues;
+
     Matrix4x4 m_Projection;
     Matrix4x4 m_View;
     Matrix4x4 m_Model;
@@ -60,30 +337,222 @@ private:
     Blending m_Blending;
     Stencil m_Stencil;
 
-    void CreateFramebuffer();
-    void UpdateFramebuffer();
-    void DestroyFramebuffer();
+    // Batches of the current draw, small draws that aren't instanced only use the first one
+    std::vector<VertexBatch> m_VertexBatches;
+
+    // Indices of the draws that aren't indexed
+    std::vector<uint32_t> m_SequentialIndices;
+
+    // Positions of the vertices of a draw split across the batches, transformed once for all of them
+    std::vector<Vector4> m_DrawClipPositions;
+    std::vector<Vector4> m_DrawScreenPositions;
+
+    std::vector<TriangleSetup> m_TriangleSetups;
+    std::vector<Tile> m_Tiles;
+    std::vector<uint32_t> m_ActiveTiles;
+    uint32_t m_NbrTilesX;
+    uint32_t m_NbrTilesY;
+
+    ThreadPool m_ThreadPool;
 
-    void DrawTriangle(const Vector4& p1, const Vector4& p2, const Vector4& p3,
-        const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector3& normal);
+    FragmentPath m_FragmentPath;
 
-    Vector4 ApplyTransformationPipeline(const Vertex& vertex);
-    Vector4 ApplyLights(const Vector3& position, const Vector4& currColor, const Vector3& normal);
+    // Number of varyings interpolated by the current draw
+    uint32_t m_NbrVaryings;
 
-    Vector4 NdcToScreenCoords(const Vector4& ndc, const bool ignoreZ);
+    // Pipeline the fragments of the current draw go through, and the enabled lights it loops over
+    bool m_SpecializedFragments;
+    FragmentPipeline m_Pipeline;
+    std::vector<const Light*> m_ActiveLights;
+
+    // State of the current draw used by the vectorized fragment paths, which can only
+    // write the fragments themselves when no stencil, light or blending is involved
+    bool m_FastFragments;
+    // Whether the fragments hidden behind the hierarchical depth buffer can be skipped, when the stencil
+    // doesn't update them
+    bool m_SkipHiddenFragments;
+    const Vector4* m_TextureData;
+    int32_t m_TextureWidth;
+    int32_t m_TextureHeight;
+
+    void CreateFramebuffer();
+    void UpdateFramebuffer();
+    void DestroyFramebuffer();
+    // Gets the color buffer with its pixels in rows, copied to m_LinearColorBuffer when it's tiled
+    const void* GetLinearColorBuffer();
+    // Points the color buffers at a color target
+    void SelectColorTarget(const uint32_t target);
+    // Converts a color target to RGBA8 rows, on the present thread
+    void ConvertColorTarget(const uint32_t target, uint8_t* const staging) const;
+
+    uint32_t ComputeOutcode(const Vector4& position) const;
+    // Whether the cull mode discards a triangle, from twice its signed area on the screen or any value of the same sign
+    bool IsCulledByFacing(const float area) const;
+    void ClipTriangle(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t indices[3],
+        const uint32_t face, const uint32_t planes);
+    uint32_t AddClippedVertex(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t inside,
+        const uint32_t outside, const float t);
+
+    void BeginDraw();
+    void DrawTriangles(const std::vector<Vertex>& vertices, const uint32_t* const indices, const uint32_t nbrIndices);
+    // Splits a large draw across the batches : its vertices are transformed, then its triangles assembled and set up,
+    // in parallel. The batches are submitted in order, so the triangles keep the order of the draw
+    void ProcessDraw(const std::vector<Vertex>& vertices, const uint32_t* const indices, const uint32_t nbrTriangles,
+        const uint32_t nbrBatches);
+    // Transforms the vertices of an instance, assembles its triangles and sets them up, only touching the batch
+    void ProcessInstance(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t* const indices,
+        const uint32_t nbrIndices, const Matrix4x4& model);
+    // Assembles the triangles from the positions the batch points to, and sets them up
+    void AssembleTriangles(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t* const indices,
+        const uint32_t nbrTriangles);
+    // Bins the triangles of a batch, in order, and adds its statistics to the frame's
+    void SubmitBatch(VertexBatch& batch);
+
+    // Transforms the listed vertices to clip space and to the screen, with the instruction set of the fragment path
+    void TransformVertices(const Matrix4x4& mvp, const std::vector<Vertex>& vertices, const uint32_t* const list,
+        const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const;
+    template <typename Lanes>
+    void TransformVerticesSimd(const Matrix4x4& mvp, const Vertex* const vertices, const uint32_t* const list,
+        const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const;
+
+    bool SetupTriangle(const Vector4& p1, const Vector4& p2, const Vector4& p3,
+        const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector3& normal, TriangleSetup& setup);
+    void DrawTriangle(const TriangleSetup& setup, Tile& tile);
+    template <bool TestCoverage, StencilMode StencilTest, FinishFragmentFunc Finish>
+    void DrawBlock(const TriangleSetup& setup, Tile& tile,
+        const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3]);
+    template <StencilMode StencilTest, FinishFragmentFunc Finish>
+    bool ShadeFragment(const TriangleSetup& setup, const int32_t x, const int32_t y, const float planes[MAX_PLANES]);
+
+    // Offset of a pixel in the buffers of the framebuffer layout
+    uint32_t GetPixelOffset(const uint32_t x, const uint32_t y) const;
+    // Conversions between the shaded colors and depths, and the formats of the framebuffer
+    Vector4 LoadColor(const uint32_t offset) const;
+    void StoreColor(const uint32_t offset, const Vector4& color);
+    // Same as StoreColor, but never inlined, for the translation units compiled for another instruction set
+    void WriteColor(const uint32_t offset, const float r, const float g, const float b, const float a);
+    float LoadDepth(const uint32_t offset) const;
+    // Writes the depth of the fragment if it passes the depth test
+    bool TestDepth(const uint32_t offset, const float depth);
+    bool FinishFragment(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+        const float varyings[MAX_VARYINGS]);
+    Vector4 ComputeFragmentColor(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+        const float varyings[MAX_VARYINGS], const int32_t texture, const Material& material);
+
+    // Same as FinishFragment and ComputeFragmentColor, with the render state known at compile time
+    template <TextureMode Texturing, BlendMode Blend, LightMode Lighting>
+    bool FinishSpecializedFragment(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+        const float varyings[MAX_VARYINGS]);
+    template <TextureMode Texturing, LightMode Lighting>
+    Vector4 ComputeSpecializedColor(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+        const float varyings[MAX_VARYINGS], const int32_t texture, const Material& material);
+
+    template <uint32_t Key>
+    static constexpr FragmentPipeline CreateFragmentPipeline();
+    template <uint32_t... Keys>
+    static constexpr std::array<FragmentPipeline, sizeof...(Keys)> CreateFragmentPipelines(
+        std::integer_sequence<uint32_t, Keys...>);
+
+    void UpdateActiveLights();
+    const FragmentPipeline& GetFragmentPipeline(const int32_t texture, const BlendMode blend,
+        const StencilMode stencil) const;
+
+    // Rasterizes and shades a whole aligned block several pixels at a time, returns false if the block
+    // can't be handled (edge functions out of 32 bits range) and must go through the scalar path
+    template <typename Lanes>
+    bool DrawBlockSimd(const TriangleSetup& setup, Tile& tile, const int32_t blockX, const int32_t blockY,
+        const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3], const bool inside);
+
+    void CreateTiles();
+    void UpdateTileMaxDepth(Tile& tile);
+    // Fills the pending pixels of a tile with the values of the last clear : its colors, and its depths and stencil
+    // values when they're needed too
+    void ClearTile(Tile& tile, const bool depth);
+    // Clears the tile of a pixel read or written from outside of the rasterization
+    void ClearPixelTile(const uint32_t x, const uint32_t y);
+    void BinTriangle(const uint32_t index);
+    void RasterizeTiles();
+
+    Vector4 ApplyLights(const Vector3& position, const Vector4& currColor, const Vector3& normal, const Material& material);
+    Vector4 ComputeLight(const Light& light, const Vector3& position, const Vector3& normal, const Material& material) const;
+
+    Vector4 NdcToScreenCoords(const Vector4& ndc, const bool ignoreZ) const;
+    Vector4 ClipToScreenCoords(const Vector4& clip) const;
 
     Vector3 m_CameraScreenPosition;
 
 public:
-    Camera Camera;
+    ::Camera Camera;
     std::vector<Light> m_Lights;
     Material CurrentMaterial;
 
-    bool EnableBackfaceCulling;
-
+    // Whether objects are drawn with the level of detail matching their size on the screen
+    bool EnableLod;
+    // Whether objects entirely outside of the view are skipped before transforming any vertex
+    bool EnableFrustumCulling;
+    // Whether objects hidden behind the occluders are skipped before transforming any vertex
+    bool EnableOcclusionCulling;
+
+    // Statistics of the current frame, reset by ClearBuffers
+    // Objects whose bounds are entirely outside of the view, which weren't drawn
+    uint32_t NbrObjectsCulled;
+    // Objects tested against the occlusion buffer, and the ones entirely behind the occluders which weren't drawn
+    uint32_t NbrObjectsOcclusionTested;
+    uint32_t NbrObjectsOccluded;
+    // Occluders drawn to the occlusion buffer
+    uint32_t NbrOccludersDrawn;
     uint32_t NbrTrianglesRendered;
-
-    Renderer(uint32_t width, uint32_t height);
+    // Triangles entirely outside of one of the frustum planes, rejected before being clipped
+    uint32_t NbrTrianglesCulled;
+    // Triangles crossing the near or far plane, or going past the guard band, that were clipped
+    uint32_t NbrTrianglesClipped;
+    // Triangles discarded by the cull mode, before their setup
+    uint32_t NbrTrianglesCulledByFacing;
+    // Pixels that went through a coverage test, pixels of blocks fully inside of a triangle skip it
+    uint64_t NbrPixelsTested;
+    // Fragments that passed the coverage and depth tests and were shaded
+    uint64_t NbrPixelsShaded;
+    // Triangle/tile pairs rejected by the hierarchical depth buffer, without visiting any pixel
+    uint32_t NbrTilesRejected;
+    // Triangle/block pairs rejected by the hierarchical depth buffer, in tiles the triangle wasn't rejected from
+    uint32_t NbrBlocksRejected;
+    // Vertices that went through the transformation pipeline, each once per draw (or instance) referencing it
+    uint32_t NbrVerticesTransformed;
+    // Draws submitted, an instanced draw counts once whatever its number of instances
+    uint32_t NbrDraws;
+    // Time spent in ClearBuffers, in milliseconds
+    double ClearTime;
+    // Time spent by ResolveClears filling the tiles nothing was drawn on since the clear, in milliseconds
+    double ClearResolveTime;
+    // Time PresentFrame held the renderer, resolving the clears and waiting for the next color target, in milliseconds
+    double PresentTime;
+    // Time the present thread spent converting the latest frame it finished, in milliseconds
+    double ConvertTime;
+    // Time spent finding the objects in the view, in milliseconds
+    double CullingTime;
+    // Time spent drawing the occluders and testing the objects against them, in milliseconds
+    double OcclusionTime;
+    // Time spent transforming the vertices, assembling the triangles and setting them up, in milliseconds
+    double VertexTime;
+    // Part of it spent in the vertex transform itself, summed over the threads, in milliseconds
+    double TransformTime;
+    // Time spent rasterizing and shading the tiles, in milliseconds
+    double RasterizationTime;
+
+    /// <summary>
+    /// Creates a renderer
+    /// </summary>
+    /// <param name="width">Framebuffer width</param>
+    /// <param name="height">Framebuffer height</param>
+    /// <param name="nbrThreads">Number of threads the tiles are rasterized with, 0 to use every core</param>
+    /// <param name="colorFormat">Format the color buffer stores its pixels in</param>
+    /// <param name="depthFormat">Format the depth and stencil buffers store their pixels in</param>
+    /// <param name="layout">Layout of the pixels in the buffers</param>
+    /// <param name="nbrColorTargets">Color targets the frames are drawn in in turn, more than 1 converts the
+    /// presented frames on a present thread while the next ones are drawn</param>
+    Renderer(uint32_t width, uint32_t height, uint32_t nbrThreads = 0, ColorFormat colorFormat = ColorFormat::RGBA32F,
+        DepthFormat depthFormat = DepthFormat::D32F, FramebufferLayout layout = FramebufferLayout::LINEAR,
+        uint32_t nbrColorTargets = 1);
     ~Renderer();
 
     void SetProjectionMatrix(const Matrix4x4& projection);
@@ -103,9 +572,88 @@ public:
 
     void ProcessVertices(const std::vector<Vertex>& vertices);
 
+    /// <summary>
+    /// Draws indexed triangles, vertices shared by several triangles are only transformed once
+    /// </summary>
+    /// <param name="vertices">Vertices of the draw</param>
+    /// <param name="indices">Indices of the vertices of each triangle, 3 per triangle</param>
+    void DrawIndexed(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+    /// <summary>
+    /// Draws indexed triangles once per model matrix, the instances are processed in parallel and all their
+    /// triangles are rasterized together, in the order of the instances
+    /// </summary>
+    /// <param name="vertices">Vertices of the draw, shared by every instance</param>
+    /// <param name="indices">Indices of the vertices of each triangle, 3 per triangle</param>
+    /// <param name="models">Model matrix of each instance</param>
+    void DrawInstanced(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+        const std::span<const Matrix4x4> models);
+
+    /// <summary>
+    /// Clears the framebuffer, which only flags its tiles : each one is filled with the clear values before the first
+    /// triangle drawn on it, or by ResolveClears
+    /// </summary>
     void ClearBuffers();
+
+    /// <summary>
+    /// Fills the tiles nothing was drawn on since the last clear, before the whole framebuffer is read
+    /// </summary>
+    void ResolveClears();
+
+    /// <summary>
+    /// Ends the frame : resolves the clears, and with several color targets hands the frame to the present thread
+    /// and moves on to the next target. Like the back buffer of a swap chain, that target holds an older frame
+    /// until it's cleared
+    /// </summary>
+    void PresentFrame();
+
+    /// <summary>
+    /// Waits for the frames being converted by the present thread, and gets the latest one
+    /// </summary>
+    /// <returns>RGBA8 rows of the frame, first row at the top, nullptr with a single color target</returns>
+    const uint8_t* GetPresentedFrame();
+
+    uint32_t GetNbrColorTargets() const;
+
+    /// <summary>
+    /// Tests the bounds of an object against the frustum of the camera, always true when frustum culling is disabled
+    /// </summary>
+    /// <param name="bounds">Bounds of the object, in model space</param>
+    /// <param name="model">Model matrix of the object</param>
+    /// <returns>False if the object is entirely outside of the view</returns>
+    bool IsVisible(const Bounds& bounds, const Matrix4x4& model) const;
+
+    /// <summary>
+    /// Draws the depth of an occluder to the occlusion buffer, cleared by ClearBuffers
+    /// </summary>
+    /// <param name="vertices">Vertices of the occluder</param>
+    /// <param name="indices">Indices of the vertices of each triangle, 3 per triangle</param>
+    /// <param name="model">Model matrix of the occluder</param>
+    void DrawOccluder(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Matrix4x4& model);
+
+    /// <summary>
+    /// Tests the bounds of an object against the occluders drawn this frame, always false when occlusion culling is disabled
+    /// </summary>
+    /// <param name="bounds">Bounds of the object, in model space</param>
+    /// <param name="model">Model matrix of the object</param>
+    /// <returns>True if the object is entirely behind the occluders</returns>
+    bool IsOccluded(const Bounds& bounds, const Matrix4x4& model) const;
+
+    /// <summary>
+    /// Shades the pixels of the visibility buffer written since the last resolve, does nothing in forward mode
+    /// </summary>
+    void ResolveVisibilityBuffer();
+#ifndef RENDERER_HEADLESS
     void ForwardToImgui();
 
+    /// <summary>
+    /// Retrieves the pixel clicked in the framebuffer window since the last call
+    /// </summary>
+    /// <param name="pixel">Pixel clicked, from the top left corner of the framebuffer</param>
+    /// <returns>False if the framebuffer wasn't clicked</returns>
+    bool GetViewportClick(Vector2& pixel);
+#endif
+
     void BindTexture(int32_t id);
     int32_t AddTexture(const char* const fileName);
     int32_t AddTexture(const uint8_t* const data, const uint32_t width, const uint32_t height, const uint32_t nbrChannels);
@@ -116,9 +664,159 @@ public:
     void SetBlendState(const BlendOp leftOp, const BlendOp rightOp, const BlendEquation equation);
 
     void SetStencilState(const bool enabled);
-    void SetStencilState(const StencilOp operation);
-    void SetStencilState(const bool enabled, const StencilOp operation);
-    
+
+    /// <summary>
+    /// Sets the stencil test, the fragments failing it are discarded before their depth test and their shading
+    /// </summary>
+    /// <param name="func">Comparison between the reference value and the value of the pixel</param>
+    /// <param name="ref">Reference value, also written by StencilOp::REPLACE</param>
+    /// <param name="readMask">Bits of the reference and the pixel compared</param>
+    void SetStencilFunc(const StencilFunc func, const uint8_t ref, const uint8_t readMask = 0xff);
+
+    /// <summary>
+    /// Sets how the stencil value of a pixel is updated, depending on the tests its fragment passes
+    /// </summary>
+    /// <param name="stencilFail">Operation when the stencil test fails</param>
+    /// <param name="depthFail">Operation when the stencil test passes, but the depth test fails</param>
+    /// <param name="depthPass">Operation when both tests pass</param>
+    void SetStencilOp(const StencilOp stencilFail, const StencilOp depthFail, const StencilOp depthPass);
+
+    void SetStencilWriteMask(const uint8_t writeMask);
+
+    /// <summary>
+    /// Selects the fragment path, which the vertex transform uses too, paths the CPU doesn't support fall back
+    /// to the widest supported one
+    /// </summary>
+    /// <param name="path">Fragment path</param>
+    void SetFragmentPath(const FragmentPath path);
+    FragmentPath GetFragmentPath() const;
+
+    /// <summary>
+    /// Selects how fragments are shaded, draws using blending or the stencil buffer are always rendered forward
+    /// </summary>
+    /// <param name="mode">Render mode</param>
+    void SetRenderMode(const RenderMode mode);
+    RenderMode GetRenderMode() const;
+
+    /// <summary>
+    /// Selects the triangles discarded during primitive assembly from the winding they're projected with
+    /// </summary>
+    /// <param name="mode">Faces to cull, none by default</param>
+    void SetCullMode(const CullMode mode);
+    CullMode GetCullMode() const;
+
+    /// <summary>
+    /// Selects the winding of the front facing triangles, once projected on the screen
+    /// </summary>
+    /// <param name="frontFace">Winding of the front faces, counter-clockwise by default</param>
+    void SetFrontFace(const FrontFace frontFace);
+    FrontFace GetFrontFace() const;
+
+    /// <summary>
+    /// Selects whether fragments go through pipelines specialized on the render state of the draw,
+    /// or through the generic one testing the state for each fragment
+    /// </summary>
+    /// <param name="enabled">Whether the specialized pipelines are used</param>
+    void SetSpecializedFragments(const bool enabled);
+    bool GetSpecializedFragments() const;
+
+    ColorFormat GetColorFormat() const;
+    DepthFormat GetDepthFormat() const;
+    FramebufferLayout GetLayout() const;
+
     friend class Camera;
     friend class GameObject;
 };
+
+inline uint32_t Renderer::GetPixelOffset(const uint32_t x, const uint32_t y) const
+{
+    if (m_Layout == FramebufferLayout::LINEAR)
+        return ARR_2D_IDX(x, y);
+
+    static_assert(BLOCK_SIZE == 8, "The Morton order of the micro-tiles interleaves 3 bits");
+
+    const uint32_t tile = (y / BLOCK_SIZE * m_NbrBlocksX + x / BLOCK_SIZE) * BLOCK_SIZE * BLOCK_SIZE;
+    return tile | (x & 1) | (y & 1) << 1 | (x & 2) << 1 | (y & 2) << 2 | (x & 4) << 2 | (y & 4) << 3;
+}
+
+inline Vector4 Renderer::LoadColor(const uint32_t offset) const
+{
+    switch (m_ColorFormat)
+    {
+        case ColorFormat::RGBA16F:
+            return UnpackRgba16F(m_ColorBuffer16F[offset]);
+
+        case ColorFormat::RGBA8:
+            return UnpackRgba8(m_ColorBuffer8[offset]);
+
+        default:
+            return m_ColorBuffer[offset];
+    }
+}
+
+inline void Renderer::StoreColor(const uint32_t offset, const Vector4& color)
+{
+    switch (m_ColorFormat)
+    {
+        case ColorFormat::RGBA16F:
+            m_ColorBuffer16F[offset] = PackRgba16F(color);
+            break;
+
+        case ColorFormat::RGBA8:
+            m_ColorBuffer8[offset] = PackRgba8(color);
+            break;
+
+        default:
+            m_ColorBuffer[offset] = color;
+    }
+}
+
+inline float Renderer::LoadDepth(const uint32_t offset) const
+{
+    switch (m_DepthFormat)
+    {
+        case DepthFormat::D24S8:
+            return DequantizeDepth(m_DepthBuffer24[offset] >> 8, DEPTH24_BITS);
+
+        case DepthFormat::D16:
+            return DequantizeDepth(m_DepthBuffer16[offset], DEPTH16_BITS);
+
+        default:
+            return m_DepthBuffer[offset];
+    }
+}
+
+inline bool Renderer::TestDepth(const uint32_t offset, const float depth)
+{
+    switch (m_DepthFormat)
+    {
+        case DepthFormat::D24S8:
+        {
+            // The stencil in the low byte is kept as is
+            const uint32_t word = m_DepthBuffer24[offset];
+            const uint32_t value = QuantizeDepth(depth, DEPTH24_BITS);
+            if (value >= word >> 8)
+                return false;
+
+            m_DepthBuffer24[offset] = value << 8 | (word & 0xff);
+            return true;
+        }
+
+        case DepthFormat::D16:
+        {
+            const uint32_t value = QuantizeDepth(depth, DEPTH16_BITS);
+            if (value >= m_DepthBuffer16[offset])
+                return false;
+
+            m_DepthBuffer16[offset] = static_cast<uint16_t>(value);
+            return true;
+        }
+
+        default:
+            if (!(depth < m_DepthBuffer[offset]))
+                return false;
+
+            m_DepthBuffer[offset] = depth;
+            return true;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+// The vectorized fragment paths are only available on x86
+#define RENDERER_SIMD_X86
+#endif
+
+enum class FragmentPath
+{
+	SCALAR,
+	SSE4,
+	AVX2
+};
+
+/// <summary>
+/// Gets the widest fragment path the CPU the program is running on supports
+/// </summary>
+/// <returns>Fragment path</returns>
+FragmentPath GetSupportedFragmentPath();
+
+/// <summary>
+/// Gets the name of a fragment path
+/// </summary>
+/// <param name="path">Fragment path</param>
+/// <returns>Name</returns>
+const char* GetFragmentPathName(const FragmentPath path);
@@ -2,31 +2,221 @@
 
 #include <stdint.h>
 #include <cmath>
+#include <vector>
 
+#include "renderer/fragment_pipeline.h"
+
+// Comparison between the reference value and the value of the pixel, both masked by the read mask
+enum class StencilFunc
+{
+	NEVER,
+	LESS,
+	LEQUAL,
+	GREATER,
+	GEQUAL,
+	EQUAL,
+	NOTEQUAL,
+	ALWAYS
+};
+
+// Update of the value of the pixel, only the bits of the write mask are changed
 enum class StencilOp
 {
-	WRITE,
-	DISCARD
+	KEEP,
+	ZERO,
+	REPLACE,
+	// Clamped to 255
+	INCR,
+	INCR_WRAP,
+	// Clamped to 0
+	DECR,
+	DECR_WRAP,
+	INVERT
 };
 
+// 8 bits stencil buffer, with the same state as OpenGL : the value of a pixel is tested before its depth, and
+// updated by one of the 3 operations depending on which of the stencil or the depth test the fragment fails
 class Stencil
 {
 private:
 	bool m_Enabled;
 
-	StencilOp m_Operation;
+	StencilFunc m_Func;
+	uint8_t m_Ref;
+	uint8_t m_ReadMask;
+	uint8_t m_WriteMask;
+
+	// Applied when the stencil test fails, when it passes but the depth test fails, and when both pass
+	StencilOp m_StencilFail;
+	StencilOp m_DepthFail;
+	StencilOp m_DepthPass;
 
-	uint32_t m_Width;
-	uint32_t m_Height;
+	uint32_t m_NbrPixels;
+
+	// Values of the pixels, a byte every stride bytes : either their own plane, or interleaved with the depth
+	std::vector<uint8_t> m_Plane;
+	uint8_t* m_Buffer;
+	uint32_t m_Stride;
 
 public:
-	float_t* StencilBuffer;
+	/// <summary>
+	/// Creates a stencil buffer, in its own plane until another storage is given
+	/// </summary>
+	/// <param name="nbrPixels">Number of pixels stored by the buffers of the framebuffer</param>
+	Stencil(const uint32_t nbrPixels);
+
+	/// <summary>
+	/// Stores the values in another buffer instead of their own plane, such as the low bytes of D24S8 depth words
+	/// </summary>
+	/// <param name="buffer">Value of the first pixel</param>
+	/// <param name="stride">Bytes between the values of consecutive pixels</param>
+	void SetStorage(uint8_t* const buffer, const uint32_t stride);
+
+	uint8_t GetValue(const uint32_t offset) const { return m_Buffer[offset * m_Stride]; }
+	void SetValue(const uint32_t offset, const uint8_t value) { m_Buffer[offset * m_Stride] = value; }
+
+	void Clear();
+	void Clear(const uint32_t offset, const uint32_t count);
+
+	/// <summary>
+	/// Sets the test fragments have to pass, like glStencilFunc
+	/// </summary>
+	/// <param name="func">Comparison, the reference value being on the left</param>
+	/// <param name="ref">Reference value</param>
+	/// <param name="readMask">Bits of the reference and the pixel compared</param>
+	void SetFunc(const StencilFunc func, const uint8_t ref, const uint8_t readMask);
 
-	Stencil(const float width, const float height);
-	~Stencil();
+	/// <summary>
+	/// Sets how the value of the pixel is updated, like glStencilOp
+	/// </summary>
+	/// <param name="stencilFail">Operation when the stencil test fails</param>
+	/// <param name="depthFail">Operation when the stencil test passes, but the depth test fails</param>
+	/// <param name="depthPass">Operation when both tests pass</param>
+	void SetOp(const StencilOp stencilFail, const StencilOp depthFail, const StencilOp depthPass);
 
-	void SetOperation(const StencilOp operation);
-	bool ApplyOperation(const uint32_t x, const uint32_t y);
+	/// <summary>
+	/// Sets the bits of the values the operations can change, like glStencilMask
+	/// </summary>
+	/// <param name="writeMask">Bits that can be changed</param>
+	void SetWriteMask(const uint8_t writeMask);
+
+	/// <summary>
+	/// Tests the value of a pixel, and applies the stencil fail operation if it fails
+	/// </summary>
+	/// <param name="offset">Offset of the pixel</param>
+	/// <returns>True if the fragment passes the test</returns>
+	bool Test(const uint32_t offset);
+
+	// Applies the operation of a fragment that passed the stencil test, once its depth test is done
+	void ApplyDepthFail(const uint32_t offset) { Apply(offset, m_DepthFail); }
+	void ApplyDepthPass(const uint32_t offset) { Apply(offset, m_DepthPass); }
+
+	void Apply(const uint32_t offset, const StencilOp operation);
 
 	void SetEnable(const bool enabled);
+	bool IsEnabled() const;
+
+	/// <summary>
+	/// Whether the fragments failing the depth test leave the buffer as is, and so don't need to be visited at all
+	/// </summary>
+	/// <returns>True when the stencil is disabled, or its fail operations keep the values</returns>
+	bool KeepsHiddenFragments() const;
+
+	/// <summary>
+	/// Gets the fragment pipeline matching the stencil state
+	/// </summary>
+	/// <returns>Stencil mode, NONE when the stencil is disabled</returns>
+	StencilMode GetMode() const;
 };
+
+inline bool Stencil::Test(const uint32_t offset)
+{
+	const uint8_t ref = m_Ref & m_ReadMask;
+	const uint8_t value = GetValue(offset) & m_ReadMask;
+
+	bool passed = false;
+	switch (m_Func)
+	{
+		case StencilFunc::NEVER:
+			passed = false;
+			break;
+
+		case StencilFunc::LESS:
+			passed = ref < value;
+			break;
+
+		case StencilFunc::LEQUAL:
+			passed = ref <= value;
+			break;
+
+		case StencilFunc::GREATER:
+			passed = ref > value;
+			break;
+
+		case StencilFunc::GEQUAL:
+			passed = ref >= value;
+			break;
+
+		case StencilFunc::EQUAL:
+			passed = ref == value;
+			break;
+
+		case StencilFunc::NOTEQUAL:
+			passed = ref != value;
+			break;
+
+		case StencilFunc::ALWAYS:
+			passed = true;
+			break;
+	}
+
+	if (!passed)
+		Apply(offset, m_StencilFail);
+
+	return passed;
+}
+
+inline void Stencil::Apply(const uint32_t offset, const StencilOp operation)
+{
+	if (operation == StencilOp::KEEP)
+		return;
+
+	const uint8_t value = GetValue(offset);
+
+	uint8_t result = value;
+	switch (operation)
+	{
+		case StencilOp::KEEP:
+			break;
+
+		case StencilOp::ZERO:
+			result = 0;
+			break;
+
+		case StencilOp::REPLACE:
+			result = m_Ref;
+			break;
+
+		case StencilOp::INCR:
+			result = value == 0xff ? value : value + 1;
+			break;
+
+		case StencilOp::INCR_WRAP:
+			result = value + 1;
+			break;
+
+		case StencilOp::DECR:
+			result = value == 0 ? value : value - 1;
+			break;
+
+		case StencilOp::DECR_WRAP:
+			result = value - 1;
+			break;
+
+		case StencilOp::INVERT:
+			result = ~value;
+			break;
+	}
+
+	SetValue(offset, (value & ~m_WriteMask) | (result & m_WriteMask));
+}
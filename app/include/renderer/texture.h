@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <algorithm>
 #include "SudoMaths/vector4.h"
 #include "SudoMaths/vector2.h"
 
@@ -20,8 +21,6 @@ private:
 
 	TexFiltering m_Filtering;
 
-	Vector4 ApplyFiltering(const Vector2 ntc, const Vector2 texCoords) const;
-
 public:
 	Texture();
 	Texture(const char* const fileName);
@@ -33,5 +32,31 @@ public:
 	void SetFiltering(const TexFiltering filtering);
 
 	Vector4 SampleTexel(const Vector2 ntc) const;
+
+	/// <summary>
+	/// Samples the texture with a filtering known at compile time
+	/// </summary>
+	/// <param name="ntc">Normalized texture coordinates</param>
+	/// <returns>Filtered texel</returns>
+	template <TexFiltering Filtering>
+	Vector4 SampleTexel(const Vector2 ntc) const;
+
+	TexFiltering GetFiltering() const;
+
+	int32_t GetWidth() const;
+	int32_t GetHeight() const;
+	const Vector4* GetData() const;
 };
 
+template <TexFiltering Filtering>
+Vector4 Texture::SampleTexel(const Vector2 ntc) const
+{
+	const float x = std::clamp(ntc.x * m_Width, 0.0f, (float)(m_Width - 1));
+	const float y = std::clamp(ntc.y * m_Height, 0.0f, (float)(m_Height - 1));
+
+	// Linear filtering isn't implemented yet, both filterings sample the nearest texel
+	const uint32_t offset = static_cast<uint32_t>(y) * m_Width + static_cast<uint32_t>(x);
+
+	return m_Data[offset];
+}
+
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_Workers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	std::condition_variable m_Done;
+
+	const std::function<void(uint32_t)>* m_Job;
+	uint32_t m_JobSize;
+	std::atomic<uint32_t> m_NextIndex;
+
+	uint32_t m_Generation;
+	uint32_t m_NbrBusy;
+	bool m_Stopping;
+
+	void WorkerLoop();
+	void RunJob();
+
+public:
+	/// <summary>
+	/// Creates a pool, the calling thread also takes part in the jobs so nbrThreads - 1 workers are started
+	/// </summary>
+	/// <param name="nbrThreads">Total number of threads, 0 to use every core</param>
+	ThreadPool(uint32_t nbrThreads);
+	~ThreadPool();
+
+	uint32_t GetNbrThreads() const;
+
+	/// <summary>
+	/// Calls job for every index in [0, count[ across the threads of the pool and waits for all of them to finish
+	/// </summary>
+	/// <param name="count">Number of indices</param>
+	/// <param name="job">Function called with each index</param>
+	void ParallelFor(const uint32_t count, const std::function<void(uint32_t)>& job);
+};
@@ -6,6 +6,22 @@
 #include "renderer/renderer.h"
 
 #include "engine/gameobject.h"
+#include "engine/bvh.h"
+
+// Scenes with more objects than this only show the picked one in the objects window
+#define MAX_LISTED_OBJECTS 64
+
+// Distance between the instances of the benchmark scene
+#define INSTANCE_SPACING 3.f
+
+// Transform the world box of an object in the hierarchy was computed from
+struct ObjectTransform
+{
+    Vector3 Position;
+    Vector3 Rotation;
+    Vector3 Scaling;
+    bool Outlined;
+};
 
 class Scene
 {
@@ -17,16 +33,65 @@ private:
     bool m_PeekFramebuffer;
     bool m_HasDrawn;
 
+    // Hierarchy over the world boxes of the objects, refitted when their transform changes
+    Bvh m_Bvh;
+    std::vector<ObjectTransform> m_BvhTransforms;
+
+    // Objects drawn this frame, in the order they were added
+    std::vector<uint32_t> m_VisibleObjects;
+    std::vector<uint32_t> m_IntersectingObjects;
+    std::vector<std::pair<float, uint32_t>> m_RayHits;
+
+    // Consecutive visible objects drawn together by an instanced draw
+    std::vector<const GameObject*> m_InstancedObjects;
+
+    int32_t m_PickedObject;
+
+    void CreateInstances(const uint32_t nbrInstances, const size_t textureId);
+
+    void BuildBvh();
+    void UpdateBvh();
+    void FindVisibleObjects(Renderer& renderer);
+    void CullOccludedObjects(Renderer& renderer);
+
+#ifndef RENDERER_HEADLESS
     void Ui_Controls(Renderer& renderer);
     void Ui_GameObjects(Renderer& renderer);
+    void Ui_GameObject(const uint32_t index);
     void Ui_Framebuffer(Renderer& renderer);
     void Ui_Lights(Renderer& renderer);
+#endif
 
 public:
-    Scene(Renderer& renderer);
+    // Whether the objects in the view are found through the hierarchy, rather than by testing each of them
+    bool EnableBvh;
+    // Whether consecutive objects sharing their mesh, texture and material are drawn with instanced draws
+    bool EnableInstancing;
+
+    /// <summary>
+    /// Creates the scene
+    /// </summary>
+    /// <param name="renderer">Renderer the textures are added to</param>
+    /// <param name="nbrInstances">Number of cubes added on a grid around the models, to benchmark the culling</param>
+    Scene(Renderer& renderer, const uint32_t nbrInstances = 0);
     ~Scene();
     void Update(const float deltaTime, Renderer& renderer);
+    void Render(Renderer& renderer);
+
+    /// <summary>
+    /// Finds the object under a pixel, and outlines it instead of the one picked before
+    /// </summary>
+    /// <param name="renderer">Renderer whose camera the ray starts from</param>
+    /// <param name="x">Horizontal position in the framebuffer, in pixels</param>
+    /// <param name="y">Vertical position in the framebuffer, in pixels from the first row</param>
+    /// <returns>Index of the object, -1 if there is none under that pixel</returns>
+    int32_t Pick(const Renderer& renderer, const float x, const float y);
+
+    uint32_t GetNbrObjects() const;
+    const Bvh& GetBvh() const;
 
+#ifndef RENDERER_HEADLESS
     void SetImGuiContext(struct ImGuiContext* context);
     void ShowImGuiControls(Renderer& renderer);
+#endif
 };
@@ -0,0 +1,385 @@
+#include "engine/bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+static Vector3 MinCorner(const Vector3& a, const Vector3& b)
+{
+	return Vector3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+static Vector3 MaxCorner(const Vector3& a, const Vector3& b)
+{
+	return Vector3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+// Half the surface area of a box, the probability of a random ray hitting it is proportional to it
+static float HalfArea(const Vector3& min, const Vector3& max)
+{
+	const Vector3 size = max - min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static float UnionHalfArea(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB)
+{
+	return HalfArea(MinCorner(minA, minB), MaxCorner(maxA, maxB));
+}
+
+Bvh::Bvh()
+	: m_Root(BVH_NULL_NODE)
+{
+}
+
+uint32_t Bvh::AllocateNode()
+{
+	if (!m_FreeNodes.empty())
+	{
+		const uint32_t node = m_FreeNodes.back();
+		m_FreeNodes.pop_back();
+		return node;
+	}
+
+	m_Nodes.push_back(Node());
+	return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+void Bvh::FreeNode(const uint32_t node)
+{
+	m_Nodes[node].Parent = BVH_NULL_NODE;
+	m_FreeNodes.push_back(node);
+}
+
+void Bvh::SetFatBox(Node& leaf, const Vector3& min, const Vector3& max) const
+{
+	const Vector3 margin = (max - min) * BVH_LEAF_MARGIN;
+
+	leaf.Min = min - margin;
+	leaf.Max = max + margin;
+}
+
+void Bvh::Build(const std::vector<Vector3>& mins, const std::vector<Vector3>& maxs)
+{
+	const uint32_t nbrObjects = static_cast<uint32_t>(mins.size());
+
+	m_Nodes.clear();
+	m_FreeNodes.clear();
+	m_Nodes.reserve(nbrObjects * 2);
+	m_Leaves = std::vector<uint32_t>(nbrObjects);
+	m_Root = BVH_NULL_NODE;
+
+	if (nbrObjects == 0)
+		return;
+
+	std::vector<uint32_t> objects = std::vector<uint32_t>(nbrObjects);
+	for (uint32_t i = 0; i < nbrObjects; i++)
+		objects[i] = i;
+
+	m_Root = BuildRange(objects.data(), nbrObjects, mins, maxs, BVH_NULL_NODE);
+}
+
+uint32_t Bvh::BuildRange(uint32_t* const objects, const uint32_t nbrObjects,
+	const std::vector<Vector3>& mins, const std::vector<Vector3>& maxs, const uint32_t parent)
+{
+	const uint32_t node = AllocateNode();
+	m_Nodes[node].Parent = parent;
+
+	if (nbrObjects == 1)
+	{
+		const uint32_t object = objects[0];
+
+		Node& leaf = m_Nodes[node];
+		leaf.Left = BVH_NULL_NODE;
+		leaf.Right = BVH_NULL_NODE;
+		leaf.Object = object;
+		SetFatBox(leaf, mins[object], maxs[object]);
+
+		m_Leaves[object] = node;
+		return node;
+	}
+
+	// Split at the median of the centers along the axis they're the most spread on
+	Vector3 minCenter = (mins[objects[0]] + maxs[objects[0]]) * .5f;
+	Vector3 maxCenter = minCenter;
+	for (uint32_t i = 1; i < nbrObjects; i++)
+	{
+		const Vector3 center = (mins[objects[i]] + maxs[objects[i]]) * .5f;
+		minCenter = MinCorner(minCenter, center);
+		maxCenter = MaxCorner(maxCenter, center);
+	}
+
+	const Vector3 spread = maxCenter - minCenter;
+	const int axis = spread.x > spread.y && spread.x > spread.z ? 0 : (spread.y > spread.z ? 1 : 2);
+	const uint32_t half = nbrObjects / 2;
+
+	std::nth_element(objects, objects + half, objects + nbrObjects,
+		[&mins, &maxs, axis](const uint32_t a, const uint32_t b)
+		{
+			return mins[a][axis] + maxs[a][axis] < mins[b][axis] + maxs[b][axis];
+		}
+	);
+
+	// The nodes can move while the children are allocated
+	const uint32_t left = BuildRange(objects, half, mins, maxs, node);
+	const uint32_t right = BuildRange(objects + half, nbrObjects - half, mins, maxs, node);
+
+	Node& inner = m_Nodes[node];
+	inner.Left = left;
+	inner.Right = right;
+	inner.Object = BVH_NULL_NODE;
+	inner.Min = MinCorner(m_Nodes[left].Min, m_Nodes[right].Min);
+	inner.Max = MaxCorner(m_Nodes[left].Max, m_Nodes[right].Max);
+
+	return node;
+}
+
+void Bvh::RefitAncestors(uint32_t node)
+{
+	while (node != BVH_NULL_NODE)
+	{
+		Node& inner = m_Nodes[node];
+		inner.Min = MinCorner(m_Nodes[inner.Left].Min, m_Nodes[inner.Right].Min);
+		inner.Max = MaxCorner(m_Nodes[inner.Left].Max, m_Nodes[inner.Right].Max);
+
+		node = inner.Parent;
+	}
+}
+
+void Bvh::InsertLeaf(const uint32_t leaf)
+{
+	if (m_Root == BVH_NULL_NODE)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].Parent = BVH_NULL_NODE;
+		return;
+	}
+
+	const Vector3 leafMin = m_Nodes[leaf].Min;
+	const Vector3 leafMax = m_Nodes[leaf].Max;
+
+	// Go down towards the child whose surface area grows the least, until making the node itself the sibling
+	// of the leaf is cheaper than going further
+	uint32_t sibling = m_Root;
+	while (m_Nodes[sibling].Object == BVH_NULL_NODE)
+	{
+		const Node& node = m_Nodes[sibling];
+
+		const float area = HalfArea(node.Min, node.Max);
+		const float combinedArea = UnionHalfArea(node.Min, node.Max, leafMin, leafMax);
+
+		// Cost of a new parent here, and of growing this node when going further down
+		const float cost = 2.f * combinedArea;
+		const float inheritedCost = 2.f * (combinedArea - area);
+
+		float childCosts[2];
+		const uint32_t children[2] = { node.Left, node.Right };
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = m_Nodes[children[i]];
+			const float childArea = UnionHalfArea(child.Min, child.Max, leafMin, leafMax);
+
+			childCosts[i] = inheritedCost + (child.Object != BVH_NULL_NODE ? childArea : childArea - HalfArea(child.Min, child.Max));
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+
+		sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	const uint32_t oldParent = m_Nodes[sibling].Parent;
+	const uint32_t newParent = AllocateNode();
+
+	Node& parent = m_Nodes[newParent];
+	parent.Parent = oldParent;
+	parent.Left = sibling;
+	parent.Right = leaf;
+	parent.Object = BVH_NULL_NODE;
+
+	if (oldParent == BVH_NULL_NODE)
+	{
+		m_Root = newParent;
+	}
+	else if (m_Nodes[oldParent].Left == sibling)
+	{
+		m_Nodes[oldParent].Left = newParent;
+	}
+	else
+	{
+		m_Nodes[oldParent].Right = newParent;
+	}
+
+	m_Nodes[sibling].Parent = newParent;
+	m_Nodes[leaf].Parent = newParent;
+
+	RefitAncestors(newParent);
+}
+
+void Bvh::RemoveLeaf(const uint32_t leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = BVH_NULL_NODE;
+		return;
+	}
+
+	// The sibling of the leaf takes the place of their parent
+	const uint32_t parent = m_Nodes[leaf].Parent;
+	const uint32_t grandParent = m_Nodes[parent].Parent;
+	const uint32_t sibling = m_Nodes[parent].Left == leaf ? m_Nodes[parent].Right : m_Nodes[parent].Left;
+
+	m_Nodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent == BVH_NULL_NODE)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	if (m_Nodes[grandParent].Left == parent)
+		m_Nodes[grandParent].Left = sibling;
+	else
+		m_Nodes[grandParent].Right = sibling;
+
+	RefitAncestors(grandParent);
+}
+
+void Bvh::Update(const uint32_t object, const Vector3& min, const Vector3& max)
+{
+	const uint32_t leaf = m_Leaves[object];
+	Node& node = m_Nodes[leaf];
+
+	const bool contained = min.x >= node.Min.x && min.y >= node.Min.y && min.z >= node.Min.z &&
+		max.x <= node.Max.x && max.y <= node.Max.y && max.z <= node.Max.z;
+	if (contained)
+		return;
+
+	const bool overlaps = min.x <= node.Max.x && min.y <= node.Max.y && min.z <= node.Max.z &&
+		max.x >= node.Min.x && max.y >= node.Min.y && max.z >= node.Min.z;
+
+	// Refitting keeps the tree valid, but a leaf that moved away would make its ancestors cover empty space
+	if (overlaps)
+	{
+		SetFatBox(node, min, max);
+		RefitAncestors(node.Parent);
+		return;
+	}
+
+	RemoveLeaf(leaf);
+	SetFatBox(m_Nodes[leaf], min, max);
+	InsertLeaf(leaf);
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& inside, std::vector<uint32_t>& intersecting) const
+{
+	if (m_Root == BVH_NULL_NODE)
+		return;
+
+	// Nodes left to visit, and whether they're known to be inside already
+	std::vector<std::pair<uint32_t, bool>> stack;
+	stack.emplace_back(m_Root, false);
+
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back().first;
+		bool isInside = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+
+		if (!isInside)
+		{
+			const Containment containment = frustum.ClassifyBox((node.Min + node.Max) * .5f, (node.Max - node.Min) * .5f);
+			if (containment == Containment::OUTSIDE)
+				continue;
+
+			isInside = containment == Containment::INSIDE;
+		}
+
+		if (node.Object != BVH_NULL_NODE)
+		{
+			(isInside ? inside : intersecting).push_back(node.Object);
+			continue;
+		}
+
+		stack.emplace_back(node.Right, isInside);
+		stack.emplace_back(node.Left, isInside);
+	}
+}
+
+void Bvh::QueryRay(const Vector3& origin, const Vector3& direction, std::vector<std::pair<float, uint32_t>>& hits) const
+{
+	hits.clear();
+	if (m_Root == BVH_NULL_NODE)
+		return;
+
+	const Vector3 inverse = Vector3(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+
+	std::vector<uint32_t> stack;
+	stack.push_back(m_Root);
+
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		// Slabs test : the ray is in the box between the latest entry and the earliest exit of its 3 slabs
+		float entry = 0.f;
+		float exit = INFINITY;
+		for (int i = 0; i < 3; i++)
+		{
+			const float t0 = (node.Min[i] - origin[i]) * inverse[i];
+			const float t1 = (node.Max[i] - origin[i]) * inverse[i];
+
+			entry = std::max(entry, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+
+		if (entry > exit)
+			continue;
+
+		if (node.Object != BVH_NULL_NODE)
+		{
+			hits.emplace_back(entry, node.Object);
+			continue;
+		}
+
+		stack.push_back(node.Left);
+		stack.push_back(node.Right);
+	}
+
+	std::sort(hits.begin(), hits.end());
+}
+
+uint32_t Bvh::GetNbrNodes() const
+{
+	return static_cast<uint32_t>(m_Nodes.size() - m_FreeNodes.size());
+}
+
+uint32_t Bvh::GetDepth() const
+{
+	if (m_Root == BVH_NULL_NODE)
+		return 0;
+
+	uint32_t depth = 0;
+
+	std::vector<std::pair<uint32_t, uint32_t>> stack;
+	stack.emplace_back(m_Root, 1);
+
+	while (!stack.empty())
+	{
+		const auto [index, nodeDepth] = stack.back();
+		stack.pop_back();
+
+		depth = std::max(depth, nodeDepth);
+
+		const Node& node = m_Nodes[index];
+		if (node.Object == BVH_NULL_NODE)
+		{
+			stack.emplace_back(node.Left, nodeDepth + 1);
+			stack.emplace_back(node.Right, nodeDepth + 1);
+		}
+	}
+
+	return depth;
+}
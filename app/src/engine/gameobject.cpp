@@ -1,31 +1,88 @@
 #include "engine/gameobject.h"
+#include "engine/mesh_optimizer.h"
+#include "engine/mesh_simplifier.h"
 #include "renderer/renderer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include "TinyObj/tiny_obj_loader.h"
 
+// How much the ACMR is allowed to degrade to sort the triangles for overdraw
+#define OVERDRAW_THRESHOLD 1.05f
+
+// Levels of detail built for each model, each one with about half the triangles of the previous one
+#define MAX_LODS 5
+
+// Models aren't simplified below this number of triangles
+#define MIN_LOD_TRIANGLES 64
+
+// Error allowed to build the first level of detail, relatively to the radius of the model
+#define LOD_MIN_ERROR .002f
+
+// Levels of detail are picked so that their error isn't larger than this on the screen, in pixels
+#define LOD_MAX_PIXEL_ERROR 1.f
+
+// Occluders are drawn with levels of detail whose error is smaller than this, in pixels of the occlusion buffer,
+// so that a simplified occluder can't grow past the pixel around the objects tested against it
+#define OCCLUDER_MAX_PIXEL_ERROR .5f
+
+// Meshes loaded from each file, shared by the objects loading the same file for as long as one of them uses it
+static std::unordered_map<std::string, std::weak_ptr<const Mesh>> s_LoadedMeshes;
+
+// Identifies the vertices of an OBJ file, which are only shared when they have the same attributes
+struct ObjIndexHash
+{
+	size_t operator()(const tinyobj::index_t& index) const
+	{
+		size_t hash = std::hash<int32_t>()(index.vertex_index);
+		hash = hash * 31 + std::hash<int32_t>()(index.normal_index);
+		hash = hash * 31 + std::hash<int32_t>()(index.texcoord_index);
+
+		return hash;
+	}
+};
+
+struct ObjIndexEqual
+{
+	bool operator()(const tinyobj::index_t& a, const tinyobj::index_t& b) const
+	{
+		return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index &&
+			a.texcoord_index == b.texcoord_index;
+	}
+};
+
 GameObject::GameObject()
-	: Position(0.0f), Rotation(0.0f), Scaling(1.0f), ModelMaterial(1.f, 1.f, 1.f, 1.f),
-	  Hidden(false), Outlined(false), TextureId(-1)
+	: Position(0.0f), Rotation(0.0f), Scaling(1.0f), ModelMaterial(1.f, 1.f, 1.f, 1.f), TextureId(-1),
+	  Hidden(false), Outlined(false), Occluder(false)
 {
 }
 
 GameObject::GameObject(const Vector3& position, const Vector3& rotation, const Vector3& scaling)
-	: Position(position), Rotation(rotation), Scaling(scaling), ModelMaterial(1.f, 1.f, 1.f, 1.f),
-	  Hidden(false), Outlined(false), TextureId(-1)
+	: Position(position), Rotation(rotation), Scaling(scaling), ModelMaterial(1.f, 1.f, 1.f, 1.f), TextureId(-1),
+	  Hidden(false), Outlined(false), Occluder(false)
 {
 }
 
 GameObject::GameObject(const Vector3& position, const Vector3& rotation, const Vector3& scaling,
 		const char* const modelName, const Material& material, const size_t textureId)
-	: Position(position), Rotation(rotation), Scaling(scaling), ModelMaterial(material),
-	  Hidden(false), Outlined(false), TextureId(textureId)
+	: Position(position), Rotation(rotation), Scaling(scaling), ModelMaterial(material), TextureId(textureId),
+	  Hidden(false), Outlined(false), Occluder(false)
 {
 	LoadModel(modelName);
 }
 
 void GameObject::LoadModel(const char* const name)
 {
+	std::weak_ptr<const Mesh>& loadedMesh = s_LoadedMeshes[name];
+	if (std::shared_ptr<const Mesh> mesh = loadedMesh.lock())
+	{
+		m_Mesh = std::move(mesh);
+		return;
+	}
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
@@ -41,10 +98,25 @@ void GameObject::LoadModel(const char* const name)
 	if (!warning.empty())
 		std::cout << "TinyObj warning : " << warning << std::endl;
 
+	// Corners of the faces referencing the same position, normal and uvs share their vertex
+	std::unordered_map<tinyobj::index_t, uint32_t, ObjIndexHash, ObjIndexEqual> uniqueVertices;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	size_t nbrCorners = 0;
+
 	for (const tinyobj::shape_t& shape : shapes)
 	{
 		for (const tinyobj::index_t& index : shape.mesh.indices)
 		{
+			nbrCorners++;
+
+			const auto found = uniqueVertices.find(index);
+			if (found != uniqueVertices.end())
+			{
+				indices.push_back(found->second);
+				continue;
+			}
+
 			const Vector3 position = Vector3(
 				attrib.vertices[index.vertex_index * 3 + 0],
 				attrib.vertices[index.vertex_index * 3 + 1],
@@ -65,9 +137,92 @@ void GameObject::LoadModel(const char* const name)
 			const Vector4 color = Vector4(1.0f);
 
 			const Vertex vertex = Vertex(position, color, normal, uv);
-			m_Vertices.push_back(vertex);
+
+			const uint32_t vertexIndex = static_cast<uint32_t>(vertices.size());
+			uniqueVertices.emplace(index, vertexIndex);
+			indices.push_back(vertexIndex);
+			vertices.push_back(vertex);
+		}
+	}
+
+	std::cout << name << " : " << vertices.size() << " unique vertices out of " << nbrCorners << std::endl;
+
+	CreateMesh(name, std::move(vertices), std::move(indices));
+	loadedMesh = m_Mesh;
+}
+
+void GameObject::CreateMesh(const char* const name, std::vector<Vertex> vertices, std::vector<uint32_t> indices)
+{
+	const std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+	Bounds& bounds = mesh->bounds;
+	std::vector<Lod>& lods = mesh->lods;
+
+	// Reorder the triangles for the vertex cache, then group them so that the outer ones are drawn first
+	// and hide the rest, and finally store the vertices in the order they're used
+	const uint32_t nbrVertices = static_cast<uint32_t>(vertices.size());
+	const float acmr = ComputeAcmr(indices, nbrVertices);
+	const float overdraw = ComputeOverdraw(indices, vertices);
+
+	OptimizeVertexCache(indices, nbrVertices);
+	OptimizeOverdraw(indices, vertices, OVERDRAW_THRESHOLD);
+	OptimizeVertexFetch(vertices, indices);
+
+	std::cout << name << " : ACMR " << acmr << " -> " << ComputeAcmr(indices, nbrVertices)
+		<< ", overdraw " << overdraw << " -> " << ComputeOverdraw(indices, vertices) << std::endl;
+
+	// Bounding box, and bounding sphere around its center
+	bounds.Min = vertices.empty() ? Vector3() : vertices[0].m_Position;
+	bounds.Max = bounds.Min;
+	for (const Vertex& vertex : vertices)
+	{
+		for (int32_t i = 0; i < 3; i++)
+		{
+			bounds.Min[i] = std::min(bounds.Min[i], vertex.m_Position[i]);
+			bounds.Max[i] = std::max(bounds.Max[i], vertex.m_Position[i]);
+		}
+	}
+
+	bounds.Center = (bounds.Min + bounds.Max) * .5f;
+	bounds.Radius = 0.f;
+	for (const Vertex& vertex : vertices)
+		bounds.Radius = std::max(bounds.Radius, Vector3::Distance(bounds.Center, vertex.m_Position));
+
+	// Chain of simplified versions of the model, down to a few triangles. The error allowed starts small compared
+	// to the model and grows until each level removes enough triangles, so that the first levels can be used
+	// close to the camera already
+	lods.push_back({ indices, 0.f });
+	float targetError = bounds.Radius * LOD_MIN_ERROR;
+	while (lods.size() < MAX_LODS && targetError < bounds.Radius)
+	{
+		const Lod& previous = lods.back();
+
+		const uint32_t target = static_cast<uint32_t>(previous.indices.size() / 6 * 3);
+		if (target < MIN_LOD_TRIANGLES * 3)
+			break;
+
+		Lod lod;
+		const float error = SimplifyMesh(vertices, previous.indices, target, targetError, lod.indices);
+
+		// Allow more error when the level would be too close to the previous one
+		if (lod.indices.size() > previous.indices.size() * 3 / 4)
+		{
+			targetError *= 2.f;
+			continue;
 		}
+
+		// Each level is simplified from the previous one, so their errors add up
+		lod.error = previous.error + error;
+		OptimizeVertexCache(lod.indices, nbrVertices);
+		lods.push_back(lod);
 	}
+
+	std::cout << name << " : levels of detail of";
+	for (const Lod& lod : lods)
+		std::cout << " " << lod.indices.size() / 3;
+	std::cout << " triangles" << std::endl;
+
+	mesh->vertices = std::move(vertices);
+	m_Mesh = mesh;
 }
 
 void GameObject::CalculateModelMatrix(Matrix4x4& model) const
@@ -75,9 +230,203 @@ void GameObject::CalculateModelMatrix(Matrix4x4& model) const
 	Matrix4x4::TRS(Position, Rotation, Scaling, model);
 }
 
+// World space box around a box transformed by a model matrix, its extents are projected on each axis
+static void TransformBox(const Bounds& bounds, const Matrix4x4& model, Vector3& min, Vector3& max)
+{
+	const Vector3 center = (bounds.Min + bounds.Max) * .5f;
+	const Vector3 extents = (bounds.Max - bounds.Min) * .5f;
+
+	for (int r = 0; r < 3; r++)
+	{
+		const Vector4 row = model[r];
+		const float worldCenter = row.x * center.x + row.y * center.y + row.z * center.z + row.w;
+		const float worldExtent = std::abs(row.x) * extents.x + std::abs(row.y) * extents.y + std::abs(row.z) * extents.z;
+
+		min[r] = worldCenter - worldExtent;
+		max[r] = worldCenter + worldExtent;
+	}
+}
+
+static bool IsSameVector(const Vector4& a, const Vector4& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+bool GameObject::CanShareDraw(const GameObject& other) const
+{
+	const Material& material = other.ModelMaterial;
+
+	return m_Mesh && m_Mesh == other.m_Mesh && TextureId == other.TextureId && !Outlined && !other.Outlined &&
+		IsSameVector(ModelMaterial.Ambient, material.Ambient) && IsSameVector(ModelMaterial.Diffuse, material.Diffuse) &&
+		IsSameVector(ModelMaterial.Specular, material.Specular) && ModelMaterial.Shininess == material.Shininess;
+}
+
+void GameObject::CalculateWorldBounds(Vector3& min, Vector3& max) const
+{
+	if (!m_Mesh)
+	{
+		min = Position;
+		max = Position;
+		return;
+	}
+
+	Matrix4x4 model;
+	CalculateModelMatrix(model);
+	TransformBox(m_Mesh->bounds, model, min, max);
+
+	if (!Outlined)
+		return;
+
+	// The outline is scaled from the origin of the model, so it isn't always around the object
+	Vector3 outlineMin;
+	Vector3 outlineMax;
+	Matrix4x4::TRS(Position, Rotation, Scaling * OUTLINE_SCALING, model);
+	TransformBox(m_Mesh->bounds, model, outlineMin, outlineMax);
+
+	for (int i = 0; i < 3; i++)
+	{
+		min[i] = std::min(min[i], outlineMin[i]);
+		max[i] = std::max(max[i], outlineMax[i]);
+	}
+}
+
+bool GameObject::IsVisible(const Renderer& renderer) const
+{
+	if (!m_Mesh)
+		return false;
+
+	Matrix4x4 model;
+	CalculateModelMatrix(model);
+	if (renderer.IsVisible(m_Mesh->bounds, model))
+		return true;
+
+	if (!Outlined)
+		return false;
+
+	Matrix4x4::TRS(Position, Rotation, Scaling * OUTLINE_SCALING, model);
+	return renderer.IsVisible(m_Mesh->bounds, model);
+}
+
+bool GameObject::Raycast(const Vector3& origin, const Vector3& direction, float& distance) const
+{
+	if (!m_Mesh || m_Mesh->lods.empty() || Scaling.x == 0.f || Scaling.y == 0.f || Scaling.z == 0.f)
+		return false;
+
+	// The ray is brought to model space by the inverse of the model matrix, scaling^-1 * rotation^T * (p - position),
+	// which keeps the distances along it the same
+	Matrix4x4 rotation;
+	Matrix4x4::Rotation(Rotation, rotation);
+
+	Vector3 localOrigin;
+	Vector3 localDirection;
+	const Vector3 offset = origin - Position;
+	for (int c = 0; c < 3; c++)
+	{
+		localOrigin[c] = (rotation[0][c] * offset.x + rotation[1][c] * offset.y + rotation[2][c] * offset.z) / Scaling[c];
+		localDirection[c] = (rotation[0][c] * direction.x + rotation[1][c] * direction.y + rotation[2][c] * direction.z) / Scaling[c];
+	}
+
+	// Slabs test against the bounding box first
+	const Bounds& bounds = m_Mesh->bounds;
+	float entry = 0.f;
+	float exit = INFINITY;
+	for (int i = 0; i < 3; i++)
+	{
+		const float t0 = (bounds.Min[i] - localOrigin[i]) / localDirection[i];
+		const float t1 = (bounds.Max[i] - localOrigin[i]) / localDirection[i];
+
+		entry = std::max(entry, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+
+	if (entry > exit)
+		return false;
+
+	// Moller-Trumbore on both sides of every triangle of the full model
+	const std::vector<Vertex>& vertices = m_Mesh->vertices;
+	const std::vector<uint32_t>& indices = m_Mesh->lods[0].indices;
+
+	float closest = INFINITY;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vector3& p0 = vertices[indices[i + 0]].m_Position;
+		const Vector3 edge1 = vertices[indices[i + 1]].m_Position - p0;
+		const Vector3 edge2 = vertices[indices[i + 2]].m_Position - p0;
+
+		const Vector3 p = Vector3::CrossProduct(localDirection, edge2);
+		const float determinant = Vector3::DotProduct(edge1, p);
+		if (std::abs(determinant) < 1e-12f)
+			continue;
+
+		const float inverseDeterminant = 1.f / determinant;
+		const Vector3 s = localOrigin - p0;
+		const float u = Vector3::DotProduct(s, p) * inverseDeterminant;
+		if (u < 0.f || u > 1.f)
+			continue;
+
+		const Vector3 q = Vector3::CrossProduct(s, edge1);
+		const float v = Vector3::DotProduct(localDirection, q) * inverseDeterminant;
+		if (v < 0.f || u + v > 1.f)
+			continue;
+
+		const float t = Vector3::DotProduct(edge2, q) * inverseDeterminant;
+		if (t >= 0.f && t < closest)
+			closest = t;
+	}
+
+	if (closest == INFINITY)
+		return false;
+
+	distance = closest;
+	return true;
+}
+
+bool GameObject::IsOccluded(const Renderer& renderer) const
+{
+	if (!m_Mesh)
+		return false;
+
+	Matrix4x4 model;
+	CalculateModelMatrix(model);
+	if (!renderer.IsOccluded(m_Mesh->bounds, model))
+		return false;
+
+	if (!Outlined)
+		return true;
+
+	Matrix4x4::TRS(Position, Rotation, Scaling * OUTLINE_SCALING, model);
+	return renderer.IsOccluded(m_Mesh->bounds, model);
+}
+
+uint32_t GameObject::SelectLod(const Renderer& renderer, const Matrix4x4& model, const float screenHeight,
+	const float maxPixelError) const
+{
+	Matrix4x4 transform = model;
+	const Vector4 center = transform.Multiply(Vector4(m_Mesh->bounds.Center.x, m_Mesh->bounds.Center.y, m_Mesh->bounds.Center.z, 1.f));
+	const float scale = std::max({ std::abs(Scaling.x), std::abs(Scaling.y), std::abs(Scaling.z) });
+
+	// Distance to the closest point of the bounding sphere, the full model is used once the camera is inside of it
+	const float distance = Vector3::Distance(Vector3(center.x, center.y, center.z), renderer.Camera.Position) -
+		m_Mesh->bounds.Radius * scale;
+	if (distance <= renderer.Camera.DepthNear)
+		return 0;
+
+	// Size in pixels of 1 unit of model space at that distance
+	const float pixelsPerUnit = scale * screenHeight / (2.f * std::tan(renderer.Camera.Fov / 2.f) * distance);
+
+	// Coarsest level whose error projects to less than the limit
+	for (uint32_t i = static_cast<uint32_t>(m_Mesh->lods.size()) - 1; i > 0; i--)
+	{
+		if (m_Mesh->lods[i].error * pixelsPerUnit <= maxPixelError)
+			return i;
+	}
+
+	return 0;
+}
+
 void GameObject::Render(Renderer& renderer) const
 {
-	if (Hidden)
+	if (Hidden || !m_Mesh || m_Mesh->lods.empty())
 		return;
 
 	renderer.BindTexture(TextureId);
@@ -86,12 +435,56 @@ void GameObject::Render(Renderer& renderer) const
 	// Rotation.x = renderer.GetTime();
 	CalculateModelMatrix(renderer.m_Model);
 
-	renderer.ProcessVertices(m_Vertices);
+	const uint32_t lod = renderer.EnableLod ? SelectLod(renderer, renderer.m_Model, renderer.m_Height, LOD_MAX_PIXEL_ERROR) : 0;
+	renderer.DrawIndexed(m_Mesh->vertices, m_Mesh->lods[lod].indices);
+}
+
+void GameObject::RenderInstanced(Renderer& renderer, const std::span<const GameObject* const> objects)
+{
+	if (objects.empty())
+		return;
+
+	const GameObject& first = *objects[0];
+	if (!first.m_Mesh || first.m_Mesh->lods.empty())
+		return;
+
+	renderer.BindTexture(first.TextureId);
+	renderer.CurrentMaterial = first.ModelMaterial;
+
+	// One draw per level of detail, with the instances in the order of the objects
+	std::vector<std::vector<Matrix4x4>> models = std::vector<std::vector<Matrix4x4>>(first.m_Mesh->lods.size());
+	for (const GameObject* const go : objects)
+	{
+		Matrix4x4 model;
+		go->CalculateModelMatrix(model);
+
+		const uint32_t lod = renderer.EnableLod ? go->SelectLod(renderer, model, renderer.m_Height, LOD_MAX_PIXEL_ERROR) : 0;
+		models[lod].push_back(model);
+	}
+
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (!models[i].empty())
+			renderer.DrawInstanced(first.m_Mesh->vertices, first.m_Mesh->lods[i].indices, models[i]);
+	}
+}
+
+void GameObject::RenderOccluder(Renderer& renderer) const
+{
+	if (Hidden || !m_Mesh || m_Mesh->lods.empty())
+		return;
+
+	Matrix4x4 model;
+	CalculateModelMatrix(model);
+
+	// The occlusion buffer is small enough for a coarse level of detail, whether or not the objects use them
+	const uint32_t lod = SelectLod(renderer, model, OCCLUSION_HEIGHT, OCCLUDER_MAX_PIXEL_ERROR);
+	renderer.DrawOccluder(m_Mesh->vertices, m_Mesh->lods[lod].indices, model);
 }
 
 void GameObject::RenderOutlined(Renderer& renderer) const
 {
-	if (Hidden)
+	if (Hidden || !m_Mesh || m_Mesh->lods.empty())
 		return;
 
 	renderer.BindTexture(TextureId);
@@ -99,14 +492,21 @@ void GameObject::RenderOutlined(Renderer& renderer) const
 	CalculateModelMatrix(renderer.m_Model);
 
 	// Draw and write to stencil buffer
-	renderer.SetStencilState(true, StencilOp::WRITE);
-	renderer.ProcessVertices(m_Vertices);
+	const uint32_t lod = renderer.EnableLod ? SelectLod(renderer, renderer.m_Model, renderer.m_Height, LOD_MAX_PIXEL_ERROR) : 0;
+	const std::vector<uint32_t>& indices = m_Mesh->lods[lod].indices;
+
+	renderer.SetStencilState(true);
+	renderer.SetStencilFunc(StencilFunc::ALWAYS, 1);
+	renderer.SetStencilOp(StencilOp::KEEP, StencilOp::KEEP, StencilOp::REPLACE);
+	renderer.DrawIndexed(m_Mesh->vertices, indices);
 
+	// The scaled model only goes around the pixels of the object, which are rejected before their depth is written
 	renderer.BindTexture(-1);
-	renderer.SetStencilState(StencilOp::DISCARD);
+	renderer.SetStencilFunc(StencilFunc::NOTEQUAL, 1);
+	renderer.SetStencilOp(StencilOp::KEEP, StencilOp::KEEP, StencilOp::KEEP);
 
-	Matrix4x4::TRS(Position, Rotation, Scaling * 1.05f, renderer.m_Model);
-	renderer.ProcessVertices(m_Vertices);
+	Matrix4x4::TRS(Position, Rotation, Scaling * OUTLINE_SCALING, renderer.m_Model);
+	renderer.DrawIndexed(m_Mesh->vertices, indices);
 
 	renderer.SetStencilState(false);
 }
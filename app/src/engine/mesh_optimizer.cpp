@@ -0,0 +1,445 @@
+#include "engine/mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Parameters of Tom Forsyth's vertex scoring : the cache modeled while ordering the triangles,
+// the score of the vertices of the last triangle, how fast the score decays in the rest of the cache,
+// and the bonus of the vertices with few triangles left, so that they're finished instead of left behind
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+// Resolution of the views the overdraw is measured from
+#define OVERDRAW_GRID_SIZE 256
+
+#define NO_TRIANGLE UINT32_MAX
+
+static float ComputeVertexScore(const int32_t cachePosition, const uint32_t nbrTrianglesLeft)
+{
+	// Vertices no triangle uses anymore don't attract any
+	if (nbrTrianglesLeft == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		// The vertices of the last triangle get a fixed score, so that the next triangle doesn't just reuse its edge
+		if (cachePosition < 3)
+		{
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const float scale = 1.f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(nbrTrianglesLeft), -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, const uint32_t nbrVertices)
+{
+	const uint32_t nbrTriangles = static_cast<uint32_t>(indices.size() / 3);
+	if (nbrTriangles == 0)
+		return;
+
+	// Triangles using each vertex, stored contiguously : the ones left are at the start of each range
+	std::vector<uint32_t> offsets = std::vector<uint32_t>(nbrVertices + 1, 0);
+	for (const uint32_t index : indices)
+		offsets[index + 1]++;
+
+	std::vector<uint32_t> nbrTrianglesLeft = std::vector<uint32_t>(nbrVertices);
+	for (uint32_t i = 0; i < nbrVertices; i++)
+	{
+		nbrTrianglesLeft[i] = offsets[i + 1];
+		offsets[i + 1] += offsets[i];
+	}
+
+	std::vector<uint32_t> vertexTriangles = std::vector<uint32_t>(indices.size());
+	std::vector<uint32_t> fill = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+	for (uint32_t i = 0; i < indices.size(); i++)
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+
+	std::vector<int32_t> cachePositions = std::vector<int32_t>(nbrVertices, -1);
+	std::vector<float> vertexScores = std::vector<float>(nbrVertices);
+	for (uint32_t i = 0; i < nbrVertices; i++)
+		vertexScores[i] = ComputeVertexScore(-1, nbrTrianglesLeft[i]);
+
+	std::vector<float> triangleScores = std::vector<float>(nbrTriangles);
+	std::vector<bool> added = std::vector<bool>(nbrTriangles, false);
+
+	uint32_t bestTriangle = 0;
+	for (uint32_t i = 0; i < nbrTriangles; i++)
+	{
+		const uint32_t* const triangle = &indices[i * 3];
+		triangleScores[i] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+
+		if (triangleScores[i] > triangleScores[bestTriangle])
+			bestTriangle = i;
+	}
+
+	// The cache is ordered from the most recently used vertex, vertices past its size were just evicted
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t cacheSize = 0;
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t nextTriangle = 0;
+	for (uint32_t i = 0; i < nbrTriangles; i++)
+	{
+		if (bestTriangle == NO_TRIANGLE)
+		{
+			// None of the vertices in the cache has triangles left, start over from the next triangle in the input
+			while (added[nextTriangle])
+				nextTriangle++;
+
+			bestTriangle = nextTriangle;
+		}
+
+		const uint32_t* const triangle = &indices[bestTriangle * 3];
+		added[bestTriangle] = true;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			const uint32_t vertex = triangle[j];
+
+			// Move the triangle past the ones left
+			uint32_t* const begin = &vertexTriangles[offsets[vertex]];
+			uint32_t* const last = begin + nbrTrianglesLeft[vertex] - 1;
+			std::iter_swap(std::find(begin, last, bestTriangle), last);
+
+			nbrTrianglesLeft[vertex]--;
+		}
+
+		// Put the vertices of the triangle in front of the cache
+		uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t newCacheSize = 0;
+
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			if (std::find(newCache, newCache + newCacheSize, triangle[j]) == newCache + newCacheSize)
+				newCache[newCacheSize++] = triangle[j];
+		}
+
+		const uint32_t nbrTriangleVertices = newCacheSize;
+		for (uint32_t j = 0; j < cacheSize; j++)
+		{
+			if (std::find(newCache, newCache + nbrTriangleVertices, cache[j]) == newCache + nbrTriangleVertices)
+				newCache[newCacheSize++] = cache[j];
+		}
+
+		for (uint32_t j = 0; j < newCacheSize; j++)
+		{
+			const uint32_t vertex = newCache[j];
+
+			cachePositions[vertex] = j < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(j) : -1;
+			vertexScores[vertex] = ComputeVertexScore(cachePositions[vertex], nbrTrianglesLeft[vertex]);
+		}
+
+		cacheSize = std::min<uint32_t>(newCacheSize, FORSYTH_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheSize, cache);
+
+		// Only the triangles around the vertices whose score changed can become the best one
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = -1.f;
+
+		for (uint32_t j = 0; j < newCacheSize; j++)
+		{
+			const uint32_t vertex = newCache[j];
+
+			for (uint32_t k = 0; k < nbrTrianglesLeft[vertex]; k++)
+			{
+				const uint32_t index = vertexTriangles[offsets[vertex] + k];
+				const uint32_t* const other = &indices[index * 3];
+
+				triangleScores[index] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+				if (triangleScores[index] > bestScore)
+				{
+					bestScore = triangleScores[index];
+					bestTriangle = index;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+// Simulates a FIFO cache : a vertex is in it if less than cacheSize vertices were added since it was
+static uint32_t CountCacheMisses(const uint32_t* const triangle, std::vector<uint32_t>& cacheTimes, uint32_t& time)
+{
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		if (time - cacheTimes[triangle[i]] > ACMR_CACHE_SIZE)
+		{
+			cacheTimes[triangle[i]] = time++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+float ComputeAcmr(const std::vector<uint32_t>& indices, const uint32_t nbrVertices)
+{
+	const uint32_t nbrTriangles = static_cast<uint32_t>(indices.size() / 3);
+	if (nbrTriangles == 0)
+		return 0.f;
+
+	std::vector<uint32_t> cacheTimes = std::vector<uint32_t>(nbrVertices, 0);
+	uint32_t time = ACMR_CACHE_SIZE + 1;
+
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < nbrTriangles; i++)
+		misses += CountCacheMisses(&indices[i * 3], cacheTimes, time);
+
+	return static_cast<float>(misses) / nbrTriangles;
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const float threshold)
+{
+	const uint32_t nbrTriangles = static_cast<uint32_t>(indices.size() / 3);
+	if (nbrTriangles == 0)
+		return;
+
+	std::vector<uint32_t> cacheTimes = std::vector<uint32_t>(vertices.size(), 0);
+	uint32_t time = ACMR_CACHE_SIZE + 1;
+
+	// Hard boundaries : triangles none of whose vertices are in the cache, where the vertex cache order restarted
+	std::vector<uint32_t> hardClusters;
+	for (uint32_t i = 0; i < nbrTriangles; i++)
+	{
+		if (CountCacheMisses(&indices[i * 3], cacheTimes, time) == 3 || i == 0)
+			hardClusters.push_back(i);
+	}
+
+	hardClusters.push_back(nbrTriangles);
+
+	// Soft boundaries : the hard clusters are split again as soon as the part of the cluster so far has
+	// about the same ACMR as the whole cluster, which restarting the cache from there won't degrade much
+	std::vector<uint32_t> clusters;
+	for (uint32_t i = 0; i + 1 < hardClusters.size(); i++)
+	{
+		const uint32_t start = hardClusters[i];
+		const uint32_t end = hardClusters[i + 1];
+
+		time += ACMR_CACHE_SIZE + 1;
+
+		uint32_t clusterMisses = 0;
+		for (uint32_t j = start; j < end; j++)
+			clusterMisses += CountCacheMisses(&indices[j * 3], cacheTimes, time);
+
+		const float clusterThreshold = threshold * clusterMisses / (end - start);
+
+		time += ACMR_CACHE_SIZE + 1;
+		clusters.push_back(start);
+
+		uint32_t clusterStart = start;
+		uint32_t misses = 0;
+		for (uint32_t j = start; j + 1 < end; j++)
+		{
+			misses += CountCacheMisses(&indices[j * 3], cacheTimes, time);
+
+			if (misses <= clusterThreshold * (j + 1 - clusterStart))
+			{
+				clusters.push_back(j + 1);
+				clusterStart = j + 1;
+				misses = 0;
+				time += ACMR_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	const uint32_t nbrClusters = static_cast<uint32_t>(clusters.size());
+	clusters.push_back(nbrTriangles);
+
+	// Area weighted centroid and normal of the clusters, and of the whole mesh
+	std::vector<Vector3> centroids = std::vector<Vector3>(nbrClusters);
+	std::vector<Vector3> normals = std::vector<Vector3>(nbrClusters);
+	Vector3 meshCentroid;
+	float meshArea = 0.f;
+
+	for (uint32_t i = 0; i < nbrClusters; i++)
+	{
+		Vector3 centroid;
+		Vector3 normal;
+		float area = 0.f;
+
+		for (uint32_t j = clusters[i]; j < clusters[i + 1]; j++)
+		{
+			const Vector3& p1 = vertices[indices[j * 3 + 0]].m_Position;
+			const Vector3& p2 = vertices[indices[j * 3 + 1]].m_Position;
+			const Vector3& p3 = vertices[indices[j * 3 + 2]].m_Position;
+
+			// The length of the cross product is twice the area of the triangle
+			const Vector3 cross = Vector3::CrossProduct(p2 - p1, p3 - p1);
+			const float triangleArea = cross.Norm();
+
+			centroid += (p1 + p2 + p3) * (triangleArea / 3.f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		centroids[i] = area > 0.f ? centroid / area : vertices[indices[clusters[i] * 3]].m_Position;
+		normals[i] = normal.NormalizeSafe();
+	}
+
+	if (meshArea > 0.f)
+		meshCentroid = meshCentroid / meshArea;
+
+	// Clusters facing away from the center are on the outside of the mesh, and hide the ones behind them
+	std::vector<float> keys = std::vector<float>(nbrClusters);
+	for (uint32_t i = 0; i < nbrClusters; i++)
+		keys[i] = Vector3::DotProduct(centroids[i] - meshCentroid, normals[i]);
+
+	std::vector<uint32_t> order = std::vector<uint32_t>(nbrClusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+		[&keys](const uint32_t a, const uint32_t b)
+		{
+			return keys[a] > keys[b];
+		}
+	);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	for (const uint32_t cluster : order)
+		result.insert(result.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap = std::vector<uint32_t>(vertices.size(), UINT32_MAX);
+
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+float ComputeOverdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+	if (indices.empty())
+		return 0.f;
+
+	Vector3 minBounds = vertices[indices[0]].m_Position;
+	Vector3 maxBounds = minBounds;
+	for (const uint32_t index : indices)
+	{
+		const Vector3& position = vertices[index].m_Position;
+		for (int32_t i = 0; i < 3; i++)
+		{
+			minBounds[i] = std::min(minBounds[i], position[i]);
+			maxBounds[i] = std::max(maxBounds[i], position[i]);
+		}
+	}
+
+	// Views are fitted to the bounding sphere of the box, so that the mesh fits whatever the direction
+	const Vector3 center = (minBounds + maxBounds) * .5f;
+	const float radius = std::max(Vector3::Distance(minBounds, maxBounds) * .5f, 1e-6f);
+	const float scale = (OVERDRAW_GRID_SIZE - 1) / (2.f * radius);
+
+	std::vector<float> depthBuffer = std::vector<float>(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+	uint64_t nbrShaded = 0;
+	uint64_t nbrCovered = 0;
+
+	// Orthographic views from the faces, edges and corners of the box
+	for (int32_t view = 0; view < 27; view++)
+	{
+		const Vector3 direction = Vector3(view % 3 - 1.f, view / 3 % 3 - 1.f, view / 9 - 1.f).NormalizeSafe();
+		if (direction.NormSquared() == 0.f)
+			continue;
+
+		const Vector3 up = std::abs(direction.y) < .99f ? Vector3(0.f, 1.f, 0.f) : Vector3(1.f, 0.f, 0.f);
+		const Vector3 axisU = Vector3::CrossProduct(up, direction).Normalize();
+		const Vector3 axisV = Vector3::CrossProduct(direction, axisU);
+
+		std::fill(depthBuffer.begin(), depthBuffer.end(), INFINITY);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			float u[3];
+			float v[3];
+			float depth[3];
+
+			for (uint32_t j = 0; j < 3; j++)
+			{
+				const Vector3 position = vertices[indices[i + j]].m_Position - center;
+
+				u[j] = (Vector3::DotProduct(position, axisU) + radius) * scale;
+				v[j] = (Vector3::DotProduct(position, axisV) + radius) * scale;
+				depth[j] = Vector3::DotProduct(position, direction);
+			}
+
+			// Counter-clockwise triangles face the view when their area is negative in this basis,
+			// back faces are skipped as any renderer culling them would
+			const float area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+			if (area >= 0.f)
+				continue;
+
+			const int32_t minX = std::max(0, static_cast<int32_t>(std::floor(std::min({ u[0], u[1], u[2] }))));
+			const int32_t maxX = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int32_t>(std::ceil(std::max({ u[0], u[1], u[2] }))));
+			const int32_t minY = std::max(0, static_cast<int32_t>(std::floor(std::min({ v[0], v[1], v[2] }))));
+			const int32_t maxY = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int32_t>(std::ceil(std::max({ v[0], v[1], v[2] }))));
+
+			const float invArea = 1.f / area;
+
+			for (int32_t y = minY; y <= maxY; y++)
+			{
+				for (int32_t x = minX; x <= maxX; x++)
+				{
+					const float px = x + .5f;
+					const float py = y + .5f;
+
+					const float w0 = ((u[2] - u[1]) * (py - v[1]) - (v[2] - v[1]) * (px - u[1])) * invArea;
+					const float w1 = ((u[0] - u[2]) * (py - v[2]) - (v[0] - v[2]) * (px - u[2])) * invArea;
+					const float w2 = 1.f - w0 - w1;
+
+					if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+						continue;
+
+					const float z = w0 * depth[0] + w1 * depth[1] + w2 * depth[2];
+					float& previous = depthBuffer[y * OVERDRAW_GRID_SIZE + x];
+
+					if (z < previous)
+					{
+						previous = z;
+						nbrShaded++;
+					}
+				}
+			}
+		}
+
+		for (const float depth : depthBuffer)
+			nbrCovered += depth != INFINITY;
+	}
+
+	return nbrCovered == 0 ? 0.f : static_cast<float>(nbrShaded) / nbrCovered;
+}
@@ -0,0 +1,424 @@
+#include "engine/mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+// Weight of the planes perpendicular to the borders and seams, relatively to the ones of the triangles,
+// so that collapses moving them away from their line cost more than flattening the surface
+#define BORDER_WEIGHT 10.f
+
+// Collapses rotating the normal of a triangle further than this (cosine) would fold the surface
+#define MAX_NORMAL_CHANGE 0.25f
+
+enum class VertexKind
+{
+	// Inside of the surface, can be collapsed onto any neighbor
+	MANIFOLD,
+	// On an open edge of the surface, can only be collapsed along it
+	BORDER,
+	// One of the 2 vertices of a uv seam, collapsed along the seam together with the vertex of the other side
+	SEAM,
+	// Anything else, never collapsed
+	LOCKED
+};
+
+// Sum of squared distances to planes, as a symmetric 4x4 matrix
+struct Quadric
+{
+	float xx, xy, xz, yy, yz, zz;
+	float dx, dy, dz, dd;
+	float weight;
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	float error;
+};
+
+static void AddPlane(Quadric& quadric, const Vector3& normal, const float distance, const float weight)
+{
+	quadric.xx += weight * normal.x * normal.x;
+	quadric.xy += weight * normal.x * normal.y;
+	quadric.xz += weight * normal.x * normal.z;
+	quadric.yy += weight * normal.y * normal.y;
+	quadric.yz += weight * normal.y * normal.z;
+	quadric.zz += weight * normal.z * normal.z;
+	quadric.dx += weight * normal.x * distance;
+	quadric.dy += weight * normal.y * distance;
+	quadric.dz += weight * normal.z * distance;
+	quadric.dd += weight * distance * distance;
+	quadric.weight += weight;
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.xx += other.xx;
+	quadric.xy += other.xy;
+	quadric.xz += other.xz;
+	quadric.yy += other.yy;
+	quadric.yz += other.yz;
+	quadric.zz += other.zz;
+	quadric.dx += other.dx;
+	quadric.dy += other.dy;
+	quadric.dz += other.dz;
+	quadric.dd += other.dd;
+	quadric.weight += other.weight;
+}
+
+// Weighted average of the squared distances of the point to the planes of the quadric
+static float EvaluateQuadric(const Quadric& quadric, const Vector3& p)
+{
+	const float rx = quadric.xx * p.x + quadric.xy * p.y + quadric.xz * p.z;
+	const float ry = quadric.xy * p.x + quadric.yy * p.y + quadric.yz * p.z;
+	const float rz = quadric.xz * p.x + quadric.yz * p.y + quadric.zz * p.z;
+
+	const float error = p.x * rx + p.y * ry + p.z * rz +
+		2.f * (quadric.dx * p.x + quadric.dy * p.y + quadric.dz * p.z) + quadric.dd;
+
+	return quadric.weight > 0.f ? std::abs(error) / quadric.weight : 0.f;
+}
+
+static uint64_t GetEdgeKey(const uint32_t a, const uint32_t b)
+{
+	return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+struct PositionHash
+{
+	size_t operator()(const Vector3& position) const
+	{
+		uint32_t bits[3];
+		std::memcpy(bits, &position.x, sizeof(float));
+		std::memcpy(bits + 1, &position.y, sizeof(float));
+		std::memcpy(bits + 2, &position.z, sizeof(float));
+
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual
+{
+	bool operator()(const Vector3& a, const Vector3& b) const
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+};
+
+// Finds the vertex on the other side of the seam edge from -> to, which has to collapse along with it
+static uint32_t FindSeamPair(const uint32_t from, const uint32_t to, const std::vector<uint32_t>& wedges,
+	const std::unordered_set<uint64_t>& edges)
+{
+	const uint32_t pairFrom = wedges[from];
+
+	for (uint32_t pairTo = wedges[to]; pairTo != to; pairTo = wedges[pairTo])
+	{
+		if (edges.count(GetEdgeKey(pairFrom, pairTo)) != 0 || edges.count(GetEdgeKey(pairTo, pairFrom)) != 0)
+			return pairTo;
+	}
+
+	return UINT32_MAX;
+}
+
+// Whether moving a vertex would flip or fold one of the triangles around it
+static bool HasTriangleFlips(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& collapses, const uint32_t* const triangles, const uint32_t nbrTriangles,
+	const uint32_t from, const uint32_t to)
+{
+	const Vector3& target = vertices[to].m_Position;
+
+	for (uint32_t i = 0; i < nbrTriangles; i++)
+	{
+		const uint32_t* const triangle = &indices[triangles[i] * 3];
+
+		// Rotate the triangle so that the moved vertex comes first
+		const uint32_t corner = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+		const uint32_t b = collapses[triangle[(corner + 1) % 3]];
+		const uint32_t c = collapses[triangle[(corner + 2) % 3]];
+
+		// Triangles containing the edge disappear
+		if (b == to || c == to)
+			continue;
+
+		const Vector3& source = vertices[from].m_Position;
+		const Vector3& pb = vertices[b].m_Position;
+		const Vector3& pc = vertices[c].m_Position;
+
+		const Vector3 before = Vector3::CrossProduct(pb - source, pc - source);
+		const Vector3 after = Vector3::CrossProduct(pb - target, pc - target);
+
+		if (Vector3::DotProduct(before, after) <= MAX_NORMAL_CHANGE * before.Norm() * after.Norm())
+			return true;
+	}
+
+	return false;
+}
+
+float SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const uint32_t targetNbrIndices, const float targetError, std::vector<uint32_t>& result)
+{
+	const float maxCollapseError = targetError * targetError;
+	const uint32_t nbrVertices = static_cast<uint32_t>(vertices.size());
+
+	result = indices;
+
+	// Vertices sharing a position (split by their normal or uvs) are welded, and linked in a ring
+	std::vector<uint32_t> welds = std::vector<uint32_t>(nbrVertices);
+	std::vector<uint32_t> wedges = std::vector<uint32_t>(nbrVertices);
+	{
+		std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> positions;
+		for (uint32_t i = 0; i < nbrVertices; i++)
+		{
+			const auto inserted = positions.emplace(vertices[i].m_Position, i);
+			welds[i] = inserted.first->second;
+
+			// Insert the vertex in the ring after the first vertex of its position
+			const uint32_t first = welds[i];
+			wedges[i] = first == i ? i : wedges[first];
+			wedges[first] = i;
+		}
+	}
+
+	// Quadrics of the planes of the triangles around each position
+	std::vector<Quadric> quadrics = std::vector<Quadric>(nbrVertices, Quadric());
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		const Vector3& p0 = vertices[result[i + 0]].m_Position;
+		const Vector3& p1 = vertices[result[i + 1]].m_Position;
+		const Vector3& p2 = vertices[result[i + 2]].m_Position;
+
+		const Vector3 cross = Vector3::CrossProduct(p1 - p0, p2 - p0);
+		const float length = cross.Norm();
+		if (length == 0.f)
+			continue;
+
+		const Vector3 normal = cross / length;
+		const float distance = -Vector3::DotProduct(normal, p0);
+
+		for (uint32_t j = 0; j < 3; j++)
+			AddPlane(quadrics[welds[result[i + j]]], normal, distance, length * .5f);
+	}
+
+	float maxError = 0.f;
+	bool addedBorderPlanes = false;
+
+	std::vector<VertexKind> kinds = std::vector<VertexKind>(nbrVertices);
+	std::vector<uint32_t> collapses = std::vector<uint32_t>(nbrVertices);
+	std::vector<bool> lockedWelds = std::vector<bool>(nbrVertices);
+	std::vector<uint32_t> offsets = std::vector<uint32_t>(nbrVertices + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> candidates;
+
+	while (result.size() > targetNbrIndices)
+	{
+		const uint32_t nbrTriangles = static_cast<uint32_t>(result.size() / 3);
+
+		// Topology of the current triangles : an edge is open when no triangle uses it the other way around,
+		// seams are only open between the vertices, but closed between the welded positions
+		std::unordered_set<uint64_t> edges;
+		std::unordered_set<uint64_t> weldedEdges;
+		for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+		{
+			const uint32_t a = result[i];
+			const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+
+			edges.insert(GetEdgeKey(a, b));
+			weldedEdges.insert(GetEdgeKey(welds[a], welds[b]));
+		}
+
+		std::vector<uint32_t> nbrBorderEdges = std::vector<uint32_t>(nbrVertices, 0);
+		std::vector<uint32_t> nbrSeamEdges = std::vector<uint32_t>(nbrVertices, 0);
+		for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+		{
+			const uint32_t a = result[i];
+			const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+
+			if (weldedEdges.count(GetEdgeKey(welds[b], welds[a])) == 0)
+			{
+				nbrBorderEdges[welds[a]]++;
+				nbrBorderEdges[welds[b]]++;
+			}
+			else if (edges.count(GetEdgeKey(b, a)) == 0)
+			{
+				nbrSeamEdges[a]++;
+				nbrSeamEdges[b]++;
+			}
+		}
+
+		for (uint32_t i = 0; i < nbrVertices; i++)
+		{
+			const uint32_t weld = welds[i];
+			const bool single = wedges[i] == i;
+			const bool pair = !single && wedges[wedges[i]] == i;
+
+			if (single && nbrBorderEdges[weld] == 0)
+				kinds[i] = VertexKind::MANIFOLD;
+			else if (single && nbrBorderEdges[weld] == 2)
+				kinds[i] = VertexKind::BORDER;
+			else if (pair && nbrBorderEdges[weld] == 0 && nbrSeamEdges[i] == 2 && nbrSeamEdges[wedges[i]] == 2)
+				kinds[i] = VertexKind::SEAM;
+			else
+				kinds[i] = VertexKind::LOCKED;
+		}
+
+		// Keep the borders and seams in place : planes perpendicular to the surface along their edges
+		if (!addedBorderPlanes)
+		{
+			addedBorderPlanes = true;
+
+			for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+			{
+				const uint32_t a = result[i];
+				const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+				const uint32_t c = result[i - i % 3 + (i + 2) % 3];
+
+				if (edges.count(GetEdgeKey(b, a)) != 0)
+					continue;
+
+				const Vector3& pa = vertices[a].m_Position;
+				const Vector3 edge = vertices[b].m_Position - pa;
+				const Vector3 faceNormal = Vector3::CrossProduct(edge, vertices[c].m_Position - pa);
+				const Vector3 normal = Vector3::CrossProduct(edge, faceNormal).NormalizeSafe();
+				if (normal.NormSquared() == 0.f)
+					continue;
+
+				const float distance = -Vector3::DotProduct(normal, pa);
+				const float weight = edge.NormSquared() * BORDER_WEIGHT;
+
+				AddPlane(quadrics[welds[a]], normal, distance, weight);
+				AddPlane(quadrics[welds[b]], normal, distance, weight);
+			}
+		}
+
+		// Triangles around each vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (const uint32_t index : result)
+			offsets[index + 1]++;
+
+		for (uint32_t i = 0; i < nbrVertices; i++)
+			offsets[i + 1] += offsets[i];
+
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> fill = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+			vertexTriangles[fill[result[i]]++] = i / 3;
+
+		// Every edge the rules allow to collapse, in both directions
+		candidates.clear();
+		for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+		{
+			const uint32_t a = result[i];
+			const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+
+			for (uint32_t j = 0; j < 2; j++)
+			{
+				const uint32_t from = j == 0 ? a : b;
+				const uint32_t to = j == 0 ? b : a;
+
+				if (welds[from] == welds[to])
+					continue;
+
+				const VertexKind kind = kinds[from];
+				const bool border = weldedEdges.count(GetEdgeKey(welds[to], welds[from])) == 0 ||
+					weldedEdges.count(GetEdgeKey(welds[from], welds[to])) == 0;
+				const bool seam = !border && (edges.count(GetEdgeKey(to, from)) == 0 || edges.count(GetEdgeKey(from, to)) == 0);
+
+				const bool allowed =
+					kind == VertexKind::MANIFOLD ||
+					(kind == VertexKind::BORDER && border && kinds[to] != VertexKind::MANIFOLD) ||
+					(kind == VertexKind::SEAM && seam && (kinds[to] == VertexKind::SEAM || kinds[to] == VertexKind::LOCKED));
+
+				if (allowed)
+					candidates.push_back({ from, to, EvaluateQuadric(quadrics[welds[from]], vertices[to].m_Position) });
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Collapse& a, const Collapse& b)
+			{
+				return a.error < b.error;
+			}
+		);
+
+		// Collapse the cheapest edges first, each collapse removes about 2 triangles. The positions a collapse
+		// touched are locked until the next pass, since the topology and the candidates would be out of date
+		for (uint32_t i = 0; i < nbrVertices; i++)
+			collapses[i] = i;
+
+		std::fill(lockedWelds.begin(), lockedWelds.end(), false);
+
+		const uint32_t nbrTrianglesToRemove = nbrTriangles - targetNbrIndices / 3;
+		uint32_t nbrTrianglesRemoved = 0;
+		uint32_t nbrCollapses = 0;
+
+		for (const Collapse& collapse : candidates)
+		{
+			if (nbrTrianglesRemoved >= nbrTrianglesToRemove || collapse.error > maxCollapseError)
+				break;
+
+			const uint32_t from = collapse.from;
+			const uint32_t to = collapse.to;
+
+			if (lockedWelds[welds[from]] || lockedWelds[welds[to]])
+				continue;
+
+			uint32_t pairFrom = UINT32_MAX;
+			uint32_t pairTo = UINT32_MAX;
+			if (kinds[from] == VertexKind::SEAM)
+			{
+				pairFrom = wedges[from];
+				pairTo = FindSeamPair(from, to, wedges, edges);
+				if (pairTo == UINT32_MAX)
+					continue;
+			}
+
+			if (HasTriangleFlips(vertices, result, collapses, &vertexTriangles[offsets[from]],
+				offsets[from + 1] - offsets[from], from, to))
+				continue;
+
+			if (pairFrom != UINT32_MAX && HasTriangleFlips(vertices, result, collapses,
+				&vertexTriangles[offsets[pairFrom]], offsets[pairFrom + 1] - offsets[pairFrom], pairFrom, pairTo))
+				continue;
+
+			collapses[from] = to;
+			if (pairFrom != UINT32_MAX)
+				collapses[pairFrom] = pairTo;
+
+			AddQuadric(quadrics[welds[to]], quadrics[welds[from]]);
+
+			lockedWelds[welds[from]] = true;
+			lockedWelds[welds[to]] = true;
+
+			maxError = std::max(maxError, collapse.error);
+			nbrTrianglesRemoved += kinds[from] == VertexKind::BORDER ? 1 : 2;
+			nbrCollapses++;
+		}
+
+		if (nbrCollapses == 0)
+			break;
+
+		// Apply the collapses, and remove the triangles that became degenerate
+		size_t nbrIndices = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			const uint32_t a = collapses[result[i + 0]];
+			const uint32_t b = collapses[result[i + 1]];
+			const uint32_t c = collapses[result[i + 2]];
+
+			if (a == b || b == c || a == c)
+				continue;
+
+			result[nbrIndices++] = a;
+			result[nbrIndices++] = b;
+			result[nbrIndices++] = c;
+		}
+
+		result.resize(nbrIndices);
+	}
+
+	return std::sqrt(maxError);
+}
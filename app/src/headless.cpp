@@ -0,0 +1,690 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "renderer/renderer.h"
+#include "scene/scene.h"
+
+// Headless entry point : renders the scene without any window, OpenGL context or ImGui,
+// prints the time spent on each frame and writes the last frame to a PPM image
+
+struct Options
+{
+    uint32_t width = 800;
+    uint32_t height = 600;
+    uint32_t frames = 10;
+    uint32_t threads = 0;
+    ColorFormat colorFormat = ColorFormat::RGBA32F;
+    DepthFormat depthFormat = DepthFormat::D32F;
+    FramebufferLayout layout = FramebufferLayout::LINEAR;
+    uint32_t colorTargets = 1;
+    FragmentPath fragmentPath = GetSupportedFragmentPath();
+    RenderMode renderMode = RenderMode::FORWARD;
+    bool specializedFragments = true;
+    CullMode cullMode = CullMode::NONE;
+    FrontFace frontFace = FrontFace::CCW;
+    bool lod = true;
+    bool frustumCulling = true;
+    bool bvh = true;
+    bool occlusionCulling = true;
+    bool instancing = true;
+    uint32_t instances = 0;
+    bool hasPick = false;
+    Vector2 pick;
+    bool hasOutline = false;
+    Vector2 outline;
+    uint32_t lights = 0;
+    uint32_t fillLayers = 0;
+    bool fillBlend = false;
+    bool cacheMisses = false;
+    std::string output = "frame.ppm";
+    bool hasCamera = false;
+    Vector3 camera;
+    std::string root = RASTERIZER_APP_DIR;
+};
+
+void PrintUsage(const char* const program)
+{
+    std::cout << "Usage : " << program << " [options]" << std::endl
+        << "  --frames <n>        Number of frames to render (default 10)" << std::endl
+        << "  --size <w>x<h>      Framebuffer size (default 800x600)" << std::endl
+        << "  --threads <n>       Number of rasterization threads, 0 for every core (default 0)" << std::endl
+        << "  --color <format>    Color buffer format : rgba32f, rgba16f or rgba8 (default rgba32f)" << std::endl
+        << "  --depth <format>    Depth buffer format : d32f, d24s8 or d16 (default d32f)" << std::endl
+        << "  --layout <layout>   Layout of the framebuffer pixels : linear or tiled (default linear)" << std::endl
+        << "  --targets <n>       Color targets drawn in turn, more than 1 converts the frames on a present thread (default 1)" << std::endl
+        << "  --simd <path>       Fragment path : scalar, sse4 or avx2 (default : widest supported)" << std::endl
+        << "  --mode <mode>       Render mode : forward or deferred (default forward)" << std::endl
+        << "  --pipeline <type>   Fragment pipelines : specialized or generic (default specialized)" << std::endl
+        << "  --cull <mode>       Faces culled : none, back or front (default none)" << std::endl
+        << "  --front-face <w>    Winding of the front faces : cw or ccw (default ccw)" << std::endl
+        << "  --lod <on|off>      Levels of detail picked from the size of the objects on the screen (default on)" << std::endl
+        << "  --frustum <on|off>  Skip the objects outside of the view before transforming them (default on)" << std::endl
+        << "  --bvh <on|off>      Find the objects in the view through a bounding volume hierarchy (default on)" << std::endl
+        << "  --occlusion <on|off> Skip the objects hidden behind the occluders before transforming them (default on)" << std::endl
+        << "  --instancing <on|off> Draw the objects sharing their mesh and material with instanced draws (default on)" << std::endl
+        << "  --instances <n>     Add n cubes on a grid around the models, to benchmark the culling (default 0)" << std::endl
+        << "  --pick <x>,<y>      Print the object under that pixel after rendering" << std::endl
+        << "  --outline <x>,<y>   Outline the object under that pixel, with the stencil buffer, in every frame" << std::endl
+        << "  --lights <n>        Number of lights enabled (default 0)" << std::endl
+        << "  --fill <n>          Fill rate benchmark : draw n screen covering quads instead of the scene (default 0)" << std::endl
+        << "  --fill-blend <on|off> Blend the quads of the fill rate benchmark over each other (default off)" << std::endl
+        << "  --cache-misses <on|off> Count the cache misses of the frames with the CPU counters, on Linux (default off)" << std::endl
+        << "  --camera <x>,<y>,<z> Camera position (default : the scene's)" << std::endl
+        << "  --output <file>     PPM file the last frame is written to, empty to disable (default frame.ppm)" << std::endl
+        << "  --root <dir>        Directory the assets are loaded from (default " << RASTERIZER_APP_DIR << ")" << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int32_t i = 1; i < argc; i++)
+    {
+        const char* const arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "--frames") == 0 && hasValue)
+        {
+            options.frames = std::stoul(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--size") == 0 && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2)
+                return false;
+        }
+        else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+        {
+            options.threads = std::stoul(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--color") == 0 && hasValue)
+        {
+            const char* const format = argv[++i];
+
+            if (std::strcmp(format, "rgba32f") == 0)
+                options.colorFormat = ColorFormat::RGBA32F;
+            else if (std::strcmp(format, "rgba16f") == 0)
+                options.colorFormat = ColorFormat::RGBA16F;
+            else if (std::strcmp(format, "rgba8") == 0)
+                options.colorFormat = ColorFormat::RGBA8;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--depth") == 0 && hasValue)
+        {
+            const char* const format = argv[++i];
+
+            if (std::strcmp(format, "d32f") == 0)
+                options.depthFormat = DepthFormat::D32F;
+            else if (std::strcmp(format, "d24s8") == 0)
+                options.depthFormat = DepthFormat::D24S8;
+            else if (std::strcmp(format, "d16") == 0)
+                options.depthFormat = DepthFormat::D16;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--layout") == 0 && hasValue)
+        {
+            const char* const layout = argv[++i];
+
+            if (std::strcmp(layout, "linear") == 0)
+                options.layout = FramebufferLayout::LINEAR;
+            else if (std::strcmp(layout, "tiled") == 0)
+                options.layout = FramebufferLayout::TILED;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--targets") == 0 && hasValue)
+        {
+            options.colorTargets = std::stoul(argv[++i]);
+            if (options.colorTargets == 0)
+                return false;
+        }
+        else if (std::strcmp(arg, "--simd") == 0 && hasValue)
+        {
+            const char* const path = argv[++i];
+
+            if (std::strcmp(path, "scalar") == 0)
+                options.fragmentPath = FragmentPath::SCALAR;
+            else if (std::strcmp(path, "sse4") == 0)
+                options.fragmentPath = FragmentPath::SSE4;
+            else if (std::strcmp(path, "avx2") == 0)
+                options.fragmentPath = FragmentPath::AVX2;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--mode") == 0 && hasValue)
+        {
+            const char* const mode = argv[++i];
+
+            if (std::strcmp(mode, "forward") == 0)
+                options.renderMode = RenderMode::FORWARD;
+            else if (std::strcmp(mode, "deferred") == 0)
+                options.renderMode = RenderMode::DEFERRED;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--cull") == 0 && hasValue)
+        {
+            const char* const mode = argv[++i];
+
+            if (std::strcmp(mode, "none") == 0)
+                options.cullMode = CullMode::NONE;
+            else if (std::strcmp(mode, "back") == 0)
+                options.cullMode = CullMode::BACK;
+            else if (std::strcmp(mode, "front") == 0)
+                options.cullMode = CullMode::FRONT;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--front-face") == 0 && hasValue)
+        {
+            const char* const frontFace = argv[++i];
+
+            if (std::strcmp(frontFace, "cw") == 0)
+                options.frontFace = FrontFace::CW;
+            else if (std::strcmp(frontFace, "ccw") == 0)
+                options.frontFace = FrontFace::CCW;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--pipeline") == 0 && hasValue)
+        {
+            const char* const pipeline = argv[++i];
+
+            if (std::strcmp(pipeline, "specialized") == 0)
+                options.specializedFragments = true;
+            else if (std::strcmp(pipeline, "generic") == 0)
+                options.specializedFragments = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--lod") == 0 && hasValue)
+        {
+            const char* const lod = argv[++i];
+
+            if (std::strcmp(lod, "on") == 0)
+                options.lod = true;
+            else if (std::strcmp(lod, "off") == 0)
+                options.lod = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--frustum") == 0 && hasValue)
+        {
+            const char* const frustum = argv[++i];
+
+            if (std::strcmp(frustum, "on") == 0)
+                options.frustumCulling = true;
+            else if (std::strcmp(frustum, "off") == 0)
+                options.frustumCulling = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--bvh") == 0 && hasValue)
+        {
+            const char* const bvh = argv[++i];
+
+            if (std::strcmp(bvh, "on") == 0)
+                options.bvh = true;
+            else if (std::strcmp(bvh, "off") == 0)
+                options.bvh = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--occlusion") == 0 && hasValue)
+        {
+            const char* const occlusion = argv[++i];
+
+            if (std::strcmp(occlusion, "on") == 0)
+                options.occlusionCulling = true;
+            else if (std::strcmp(occlusion, "off") == 0)
+                options.occlusionCulling = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--instancing") == 0 && hasValue)
+        {
+            const char* const instancing = argv[++i];
+
+            if (std::strcmp(instancing, "on") == 0)
+                options.instancing = true;
+            else if (std::strcmp(instancing, "off") == 0)
+                options.instancing = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--instances") == 0 && hasValue)
+        {
+            options.instances = std::stoul(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--pick") == 0 && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%f,%f", &options.pick.x, &options.pick.y) != 2)
+                return false;
+
+            options.hasPick = true;
+        }
+        else if (std::strcmp(arg, "--outline") == 0 && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%f,%f", &options.outline.x, &options.outline.y) != 2)
+                return false;
+
+            options.hasOutline = true;
+        }
+        else if (std::strcmp(arg, "--lights") == 0 && hasValue)
+        {
+            options.lights = std::stoul(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--fill") == 0 && hasValue)
+        {
+            options.fillLayers = std::stoul(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--fill-blend") == 0 && hasValue)
+        {
+            const char* const blend = argv[++i];
+
+            if (std::strcmp(blend, "on") == 0)
+                options.fillBlend = true;
+            else if (std::strcmp(blend, "off") == 0)
+                options.fillBlend = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--cache-misses") == 0 && hasValue)
+        {
+            const char* const cacheMisses = argv[++i];
+
+            if (std::strcmp(cacheMisses, "on") == 0)
+                options.cacheMisses = true;
+            else if (std::strcmp(cacheMisses, "off") == 0)
+                options.cacheMisses = false;
+            else
+                return false;
+        }
+        else if (std::strcmp(arg, "--camera") == 0 && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%f,%f,%f", &options.camera.x, &options.camera.y, &options.camera.z) != 3)
+                return false;
+
+            options.hasCamera = true;
+        }
+        else if (std::strcmp(arg, "--output") == 0 && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else if (std::strcmp(arg, "--root") == 0 && hasValue)
+        {
+            options.root = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.width != 0 && options.height != 0;
+}
+
+// Hardware counters of the cache misses, inherited by the threads created once they're opened, so they have to be
+// opened before the renderer creates its thread pool. Only available on Linux, when the CPU counters are exposed
+class CacheCounters
+{
+private:
+    // Last level cache misses, and first level data cache read misses
+    int32_t m_Counters[2] = { -1, -1 };
+
+public:
+    bool Open()
+    {
+#ifdef __linux__
+        const uint64_t configs[2][2] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                PERF_COUNT_HW_CACHE_RESULT_MISS << 16 }
+        };
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            perf_event_attr attributes = {};
+            attributes.size = sizeof(attributes);
+            attributes.type = static_cast<uint32_t>(configs[i][0]);
+            attributes.config = configs[i][1];
+            attributes.disabled = 1;
+            attributes.inherit = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            m_Counters[i] = static_cast<int32_t>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+            if (m_Counters[i] < 0)
+                return false;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Enable(const bool enabled)
+    {
+#ifdef __linux__
+        for (const int32_t counter : m_Counters)
+        {
+            if (counter >= 0)
+                ioctl(counter, enabled ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+
+    // Counts of the threads that are still running are included
+    uint64_t Read(const uint32_t index) const
+    {
+        uint64_t value = 0;
+#ifdef __linux__
+        if (m_Counters[index] < 0 || read(m_Counters[index], &value, sizeof(value)) != sizeof(value))
+            return 0;
+#endif
+        return value;
+    }
+
+    ~CacheCounters()
+    {
+#ifdef __linux__
+        for (const int32_t counter : m_Counters)
+        {
+            if (counter >= 0)
+                close(counter);
+        }
+#endif
+    }
+};
+
+bool WritePPM(Renderer& renderer, const std::string& fileName)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file)
+        return false;
+
+    const Vector2 size = renderer.GetSize();
+    const uint32_t width = size.x;
+    const uint32_t height = size.y;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<uint8_t> row = std::vector<uint8_t>(width * 3);
+
+    // With several color targets, the renderer already moved on to the next one : the frame is the one converted
+    // to RGBA8 by the present thread, which rounds the colors the same way
+    const uint8_t* const presented = renderer.GetPresentedFrame();
+
+    // Rows are written in the same order ForwardToImgui displays them, first row at the top
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (presented != nullptr)
+            {
+                const uint8_t* const pixel = presented + (static_cast<size_t>(y) * width + x) * 4;
+
+                row[x * 3 + 0] = pixel[0];
+                row[x * 3 + 1] = pixel[1];
+                row[x * 3 + 2] = pixel[2];
+                continue;
+            }
+
+            const Vector4 pixel = renderer.GetPixel(x, y);
+
+            row[x * 3 + 0] = std::clamp(pixel.x, 0.f, 1.f) * 255.f + .5f;
+            row[x * 3 + 1] = std::clamp(pixel.y, 0.f, 1.f) * 255.f + .5f;
+            row[x * 3 + 2] = std::clamp(pixel.z, 0.f, 1.f) * 255.f + .5f;
+        }
+
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    return file.good();
+}
+
+// Draws screen covering quads from back to front, every layer passes the depth test and writes every pixel,
+// so that the frame time mostly depends on the bandwidth of the color and depth buffers
+void RenderFillLayers(Renderer& renderer, const uint32_t nbrLayers, const bool blend)
+{
+    static const Vector4 colors[] = {
+        Vector4(1.f, .25f, .25f, .5f),
+        Vector4(.25f, 1.f, .25f, .5f),
+        Vector4(.25f, .25f, 1.f, .5f)
+    };
+
+    renderer.ClearBuffers();
+
+    // Positions are given in clip space directly
+    renderer.SetProjectionMatrix(Matrix4x4::Identity);
+    renderer.SetViewMatrix(Matrix4x4::Identity);
+    renderer.SetModelMatrix(Matrix4x4::Identity);
+    renderer.BindTexture(-1);
+    if (blend)
+        renderer.SetBlendState(BlendOp::SRC_ALPHA, BlendOp::ONE_MINUS_SRC_ALPHA, BlendEquation::ADD);
+    renderer.SetBlendState(blend);
+
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+    const Vector3 normal = Vector3(0.f, 0.f, 1.f);
+    std::vector<Vertex> vertices;
+
+    for (uint32_t i = 0; i < nbrLayers; i++)
+    {
+        const float z = .9f - 1.8f * (i + 1) / (nbrLayers + 1);
+        const Vector4& color = colors[i % 3];
+
+        vertices.clear();
+        vertices.push_back(Vertex(Vector3(-1.f, -1.f, z), color, normal, Vector2(0.f, 0.f)));
+        vertices.push_back(Vertex(Vector3(1.f, -1.f, z), color, normal, Vector2(1.f, 0.f)));
+        vertices.push_back(Vertex(Vector3(1.f, 1.f, z), color, normal, Vector2(1.f, 1.f)));
+        vertices.push_back(Vertex(Vector3(-1.f, 1.f, z), color, normal, Vector2(0.f, 1.f)));
+
+        renderer.DrawIndexed(vertices, indices);
+    }
+
+    renderer.SetBlendState(false);
+    renderer.ResolveVisibilityBuffer();
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // Assets are referenced relatively to the app directory
+    const std::filesystem::path outputPath = options.output.empty() ? std::filesystem::path() :
+        std::filesystem::absolute(options.output);
+    std::filesystem::current_path(options.root);
+
+    CacheCounters cacheCounters;
+    const bool hasCacheCounters = options.cacheMisses && cacheCounters.Open();
+    if (options.cacheMisses && !hasCacheCounters)
+        std::cout << "Cache miss counters unavailable : " << std::strerror(errno) << std::endl;
+
+    Renderer* const renderer = new Renderer(options.width, options.height, options.threads, options.colorFormat,
+        options.depthFormat, options.layout, options.colorTargets);
+    Scene* const scene = new Scene(*renderer, options.instances);
+
+    renderer->SetFragmentPath(options.fragmentPath);
+    renderer->SetRenderMode(options.renderMode);
+    renderer->SetSpecializedFragments(options.specializedFragments);
+    renderer->SetCullMode(options.cullMode);
+    renderer->SetFrontFace(options.frontFace);
+    renderer->EnableLod = options.lod;
+    renderer->EnableFrustumCulling = options.frustumCulling;
+    scene->EnableBvh = options.bvh;
+    renderer->EnableOcclusionCulling = options.occlusionCulling;
+    scene->EnableInstancing = options.instancing;
+    for (uint32_t i = 0; i < options.lights && i < renderer->m_Lights.size(); i++)
+        renderer->SetLightState(i, true);
+    if (options.hasCamera)
+        renderer->Camera.Position = options.camera;
+    std::cout << "Fragment path : " << GetFragmentPathName(renderer->GetFragmentPath()) << ", "
+        << (options.renderMode == RenderMode::DEFERRED ? "deferred" : "forward") << " rendering, "
+        << (options.specializedFragments ? "specialized" : "generic") << " fragment pipelines" << std::endl;
+    std::cout << "Framebuffer : " << GetColorFormatName(options.colorFormat) << " color, "
+        << GetDepthFormatName(options.depthFormat) << " depth, "
+        << GetFramebufferLayoutName(options.layout) << " layout, "
+        << options.colorTargets << " color targets, "
+        << GetColorFormatSize(options.colorFormat) + GetDepthFormatSize(options.depthFormat) << " bytes per pixel" << std::endl;
+    if (options.hasOutline)
+    {
+        // Picked with the camera of the first frame, before anything is rendered
+        renderer->Camera.Update();
+        const int32_t outlined = scene->Pick(*renderer, options.outline.x, options.outline.y);
+        std::cout << "Outlined object at " << options.outline.x << "," << options.outline.y << " : " << outlined << std::endl;
+    }
+    std::cout << scene->GetNbrObjects() << " objects, bounding volume hierarchy of " << scene->GetBvh().GetNbrNodes()
+        << " nodes and depth " << scene->GetBvh().GetDepth() << std::endl;
+
+    using std::chrono::high_resolution_clock;
+
+    double total = 0.0;
+    double clear = 0.0;
+    double clearResolve = 0.0;
+    double present = 0.0;
+    double convert = 0.0;
+    double culling = 0.0;
+    double occlusion = 0.0;
+    uint64_t occluded = 0;
+    uint64_t occlusionTested = 0;
+    double vertex = 0.0;
+    double transform = 0.0;
+    uint64_t vertices = 0;
+    double rasterization = 0.0;
+    uint64_t fragments = 0;
+    double best = INFINITY;
+    double worst = 0.0;
+
+    cacheCounters.Enable(true);
+
+    for (uint32_t i = 0; i < options.frames; i++)
+    {
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+        if (options.fillLayers != 0)
+            RenderFillLayers(*renderer, options.fillLayers, options.fillBlend);
+        else
+            scene->Render(*renderer);
+
+        // Done by the window before showing the frame, which the PPM image is written like. With several color
+        // targets, the frame is converted on the present thread while the next one is rendered
+        renderer->PresentFrame();
+
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        total += ms;
+        best = std::min(best, ms);
+        worst = std::max(worst, ms);
+        clear += renderer->ClearTime;
+        clearResolve += renderer->ClearResolveTime;
+        present += renderer->PresentTime;
+        convert += renderer->ConvertTime;
+        culling += renderer->CullingTime;
+        occlusion += renderer->OcclusionTime;
+        occluded += renderer->NbrObjectsOccluded;
+        occlusionTested += renderer->NbrObjectsOcclusionTested;
+        vertex += renderer->VertexTime;
+        transform += renderer->TransformTime;
+        vertices += renderer->NbrVerticesTransformed;
+        rasterization += renderer->RasterizationTime;
+        fragments += renderer->NbrPixelsShaded;
+
+        std::cout << "Frame " << i << " : " << ms << " ms, "
+            << renderer->NbrObjectsCulled << " objects culled, "
+            << renderer->NbrObjectsOccluded << " occluded, "
+            << renderer->NbrDraws << " draws, "
+            << renderer->NbrVerticesTransformed << " vertices transformed, "
+            << renderer->NbrTrianglesRendered << " triangles rendered, "
+            << renderer->NbrTrianglesCulled << " culled, "
+            << renderer->NbrTrianglesClipped << " clipped, "
+            << renderer->NbrTrianglesCulledByFacing << " culled by facing, "
+            << renderer->NbrPixelsTested << " pixels tested, "
+            << renderer->NbrPixelsShaded << " pixels shaded, "
+            << renderer->NbrTilesRejected << " tiles and "
+            << renderer->NbrBlocksRejected << " blocks rejected by depth" << std::endl;
+    }
+
+    cacheCounters.Enable(false);
+
+    if (options.frames != 0)
+    {
+        std::cout << "Average : " << total / options.frames << " ms (min " << best
+            << " ms, max " << worst << " ms)" << std::endl;
+        std::cout << "Clear : " << clear / options.frames << " ms, "
+            << clearResolve / options.frames << " ms filling the tiles nothing was drawn on" << std::endl;
+        std::cout << "Present : " << present / options.frames << " ms, "
+            << convert / options.frames << " ms converting on the present thread" << std::endl;
+        std::cout << "Culling : " << culling / options.frames << " ms" << std::endl;
+        std::cout << "Occlusion : " << occlusion / options.frames << " ms, "
+            << occluded << " of " << occlusionTested << " objects tested were occluded" << std::endl;
+        std::cout << "Vertex processing : " << vertex / options.frames << " ms" << std::endl;
+        std::cout << "Vertex transform : " << transform / options.frames << " ms, "
+            << vertices / (transform * 1000.0) << " Mvertices/s" << std::endl;
+        std::cout << "Rasterization : " << rasterization / options.frames << " ms, "
+            << fragments / (rasterization * 1000.0) << " Mfragments/s" << std::endl;
+
+        if (options.fillLayers != 0)
+        {
+            // Each fragment reads and writes the whole depth and stencil pixel and writes the color, which blending
+            // reads first. The fragments are counted rather than assumed to cover the framebuffer
+            const uint64_t pixels = fragments;
+            const uint32_t bytes = GetColorFormatSize(options.colorFormat) * (options.fillBlend ? 2 : 1) +
+                GetDepthFormatSize(options.depthFormat) * 2;
+            std::cout << "Fill rate : " << pixels / (total * 1000.0) << " Mpixels/s, "
+                << pixels * bytes / (total * 1000000.0) << " GB/s of framebuffer traffic, "
+                << static_cast<double>(pixels) / (static_cast<uint64_t>(options.width) * options.height * options.frames)
+                << " layers of the framebuffer per frame" << std::endl;
+        }
+    }
+
+    if (hasCacheCounters && options.frames != 0)
+    {
+        std::cout << "Cache misses : " << cacheCounters.Read(0) / options.frames << " per frame, "
+            << cacheCounters.Read(1) / options.frames << " L1 data read misses per frame" << std::endl;
+    }
+
+    if (options.hasPick)
+    {
+        const int32_t picked = scene->Pick(*renderer, options.pick.x, options.pick.y);
+        std::cout << "Picked object at " << options.pick.x << "," << options.pick.y << " : " << picked << std::endl;
+    }
+
+    int32_t result = 0;
+    if (!outputPath.empty() && options.frames != 0)
+    {
+        if (WritePPM(*renderer, outputPath.string()))
+        {
+            std::cout << "Wrote " << outputPath.string() << std::endl;
+        }
+        else
+        {
+            std::cerr << "Couldn't write " << outputPath.string() << std::endl;
+            result = 1;
+        }
+    }
+
+    delete scene;
+    delete renderer;
+
+    return result;
+}
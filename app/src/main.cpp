@@ -112,7 +112,9 @@ int main(int argc, char** argv)
     const uint32_t width = 800;
     const uint32_t height = 600;
 
-    Renderer* const renderer = new Renderer(width, height);
+    // 2 color targets : the next frame is drawn while the present thread converts the previous one
+    Renderer* const renderer = new Renderer(width, height, 0, ColorFormat::RGBA32F, DepthFormat::D32F,
+        FramebufferLayout::LINEAR, 2);
     Scene* const scene = new Scene(*renderer);
 
     while (!glfwWindowShouldClose(window))
@@ -16,6 +16,26 @@ void Blending::SetBlending(const BlendOp leftOp, const BlendOp rightOp, const Bl
 	m_Equation = equation;
 }
 
+BlendMode Blending::GetMode() const
+{
+	if (!Enabled)
+		return BlendMode::NONE;
+
+	if (m_Equation != BlendEquation::ADD)
+		return BlendMode::GENERIC;
+
+	if (m_LeftOp == BlendOp::SRC_ALPHA && m_RightOp == BlendOp::ONE_MINUS_SRC_ALPHA)
+		return BlendMode::ALPHA;
+
+	if (m_LeftOp == BlendOp::ONE && m_RightOp == BlendOp::ONE)
+		return BlendMode::ADDITIVE;
+
+	if (m_LeftOp == BlendOp::DST_COLOR && m_RightOp == BlendOp::ZERO)
+		return BlendMode::MULTIPLY;
+
+	return BlendMode::GENERIC;
+}
+
 Vector4 Blending::ComputeBlending(const Vector4& dstColor, const Vector4& srcColor)
 {
 	const Vector4 left = ComputeOperator(m_LeftOp, dstColor, srcColor) * srcColor;
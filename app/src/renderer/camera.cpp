@@ -16,6 +16,7 @@ Camera::Camera(Renderer& renderer)
 
 	SendViewMatrix();
 	SendProjectionMatrix();
+	UpdateFrustum();
 }
 
 Camera::Camera(const Vector3& position, const Vector3& center, Renderer& renderer)
@@ -27,6 +28,7 @@ Camera::Camera(const Vector3& position, const Vector3& center, Renderer& rendere
 
 	SendViewMatrix();
 	SendProjectionMatrix();
+	UpdateFrustum();
 }
 
 Camera::Camera(const Vector3& position, const Vector3& center,
@@ -35,6 +37,7 @@ Camera::Camera(const Vector3& position, const Vector3& center,
 {
 	SendViewMatrix();
 	SendProjectionMatrix();
+	UpdateFrustum();
 }
 
 void Camera::SendViewMatrix()
@@ -56,8 +59,41 @@ void Camera::SendProjectionMatrix()
 	);
 }
 
+void Camera::UpdateFrustum()
+{
+	Matrix4x4 viewProjection = m_Renderer.m_Projection;
+	viewProjection.Multiply(m_Renderer.m_View);
+
+	m_Frustum.Extract(viewProjection);
+}
+
 void Camera::Update()
 {
 	SendViewMatrix();
 	SendProjectionMatrix();
+	UpdateFrustum();
+}
+
+const Frustum& Camera::GetFrustum() const
+{
+	return m_Frustum;
+}
+
+void Camera::ScreenToRay(const float x, const float y, Vector3& origin, Vector3& direction) const
+{
+	// Back to normalized device coordinates, the first row of the framebuffer is at y = -1
+	const Renderer::Viewport& viewport = m_Renderer.m_Viewport;
+	const float ndcX = (x - viewport.x) / viewport.width * 2.f - 1.f;
+	const float ndcY = (y - viewport.y) / viewport.height * 2.f - 1.f;
+
+	const float aspectRatio = (float)m_Renderer.m_Width / m_Renderer.m_Height;
+	const float tanHalfFov = std::tan(Fov / 2.f);
+
+	// Same basis as the view matrix, the camera looks down its -z axis
+	const Vector3 back = (Position - Center).NormalizeSafe();
+	const Vector3 right = Vector3::CrossProduct(Vector3(0.0f, 1.0f, 0.0f), back).NormalizeSafe();
+	const Vector3 up = Vector3::CrossProduct(back, right).NormalizeSafe();
+
+	origin = Position;
+	direction = (right * (ndcX * tanHalfFov * aspectRatio) + up * (ndcY * tanHalfFov) - back).NormalizeSafe();
 }
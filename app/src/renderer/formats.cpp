@@ -0,0 +1,74 @@
+#include "renderer/formats.h"
+
+uint32_t GetColorFormatSize(const ColorFormat format)
+{
+	switch (format)
+	{
+		case ColorFormat::RGBA16F:
+			return 8;
+
+		case ColorFormat::RGBA8:
+			return 4;
+
+		default:
+			return 16;
+	}
+}
+
+uint32_t GetDepthFormatSize(const DepthFormat format)
+{
+	switch (format)
+	{
+		case DepthFormat::D24S8:
+			return 4;
+
+		case DepthFormat::D16:
+			return 3;
+
+		default:
+			return 5;
+	}
+}
+
+uint32_t GetFramebufferSize(const uint32_t width, const uint32_t height, const FramebufferLayout layout)
+{
+	if (layout == FramebufferLayout::LINEAR)
+		return width * height;
+
+	return (width + 7) / 8 * 8 * ((height + 7) / 8 * 8);
+}
+
+const char* GetColorFormatName(const ColorFormat format)
+{
+	switch (format)
+	{
+		case ColorFormat::RGBA16F:
+			return "RGBA16F";
+
+		case ColorFormat::RGBA8:
+			return "RGBA8";
+
+		default:
+			return "RGBA32F";
+	}
+}
+
+const char* GetDepthFormatName(const DepthFormat format)
+{
+	switch (format)
+	{
+		case DepthFormat::D24S8:
+			return "D24S8";
+
+		case DepthFormat::D16:
+			return "D16";
+
+		default:
+			return "D32F";
+	}
+}
+
+const char* GetFramebufferLayoutName(const FramebufferLayout layout)
+{
+	return layout == FramebufferLayout::TILED ? "tiled" : "linear";
+}
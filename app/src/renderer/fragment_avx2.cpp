@@ -0,0 +1,104 @@
+#include "renderer/renderer.h"
+
+// Compiled with AVX2 enabled, only called when the CPU supports it
+#ifdef RENDERER_SIMD_X86
+
+#include <immintrin.h>
+
+struct Avx2Lanes
+{
+    typedef __m256 Float;
+    typedef __m256i Int;
+
+    // 2 quads side by side
+    static constexpr int32_t Count = 8;
+    static constexpr int32_t SizeX = 4;
+
+    static Float SetFloat(const float value) { return _mm256_set1_ps(value); }
+    static Int SetInt(const int32_t value) { return _mm256_set1_epi32(value); }
+
+    static Int OffsetX() { return _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3); }
+    static Int OffsetY() { return _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1); }
+
+    // Morton order of the tiled layout : the 2 quads one after the other
+    static Int TiledOffsetX() { return _mm256_setr_epi32(0, 1, 0, 1, 2, 3, 2, 3); }
+    static Int TiledOffsetY() { return _mm256_setr_epi32(0, 0, 1, 1, 0, 0, 1, 1); }
+
+    static Float ToFloat(const Int a) { return _mm256_cvtepi32_ps(a); }
+    static Int Truncate(const Float a) { return _mm256_cvttps_epi32(a); }
+    static Float AsFloat(const Int a) { return _mm256_castsi256_ps(a); }
+
+    static Int Add(const Int a, const Int b) { return _mm256_add_epi32(a, b); }
+    static Int Mul(const Int a, const Int b) { return _mm256_mullo_epi32(a, b); }
+    static Int And(const Int a, const Int b) { return _mm256_and_si256(a, b); }
+    static Int Greater(const Int a, const Int b) { return _mm256_cmpgt_epi32(a, b); }
+
+    static Float Add(const Float a, const Float b) { return _mm256_add_ps(a, b); }
+    static Float Mul(const Float a, const Float b) { return _mm256_mul_ps(a, b); }
+    static Float Div(const Float a, const Float b) { return _mm256_div_ps(a, b); }
+    static Float Min(const Float a, const Float b) { return _mm256_min_ps(a, b); }
+    static Float Max(const Float a, const Float b) { return _mm256_max_ps(a, b); }
+    static Float And(const Float a, const Float b) { return _mm256_and_ps(a, b); }
+    static Float Less(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Float Select(const Float a, const Float b, const Float mask) { return _mm256_blendv_ps(a, b, mask); }
+    static int32_t MoveMask(const Float a) { return _mm256_movemask_ps(a); }
+
+    static Float LoadRows(const float* const row, const uint32_t stride)
+    {
+        return _mm256_loadu2_m128(row + stride, row);
+    }
+
+    static void StoreRows(float* const row, const uint32_t stride, const Float value)
+    {
+        _mm256_storeu2_m128(row + stride, row, value);
+    }
+
+    static Int Or(const Int a, const Int b) { return _mm256_or_si256(a, b); }
+    static Int Min(const Int a, const Int b) { return _mm256_min_epi32(a, b); }
+    static Int ShiftLeft(const Int a, const int32_t bits) { return _mm256_slli_epi32(a, bits); }
+    static Int ShiftRight(const Int a, const int32_t bits) { return _mm256_srli_epi32(a, bits); }
+    static Int Select(const Int a, const Int b, const Float mask)
+    {
+        return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), mask));
+    }
+
+    // Rows of normalized depths, widened to 32 bits
+    static Int LoadRows(const uint16_t* const row, const uint32_t stride)
+    {
+        return _mm256_cvtepu16_epi32(_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + stride))));
+    }
+
+    static void StoreRows(uint16_t* const row, const uint32_t stride, const Int value)
+    {
+        const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), packed);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + stride), _mm_unpackhi_epi64(packed, packed));
+    }
+
+    static Int LoadRows(const uint32_t* const row, const uint32_t stride)
+    {
+        return _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(row + stride), reinterpret_cast<const __m128i*>(row));
+    }
+
+    static void StoreRows(uint32_t* const row, const uint32_t stride, const Int value)
+    {
+        _mm256_storeu2_m128i(reinterpret_cast<__m128i*>(row + stride), reinterpret_cast<__m128i*>(row), value);
+    }
+
+    static Float Load(const float* const src) { return _mm256_load_ps(src); }
+    static void Store(float* const dst, const Float value) { _mm256_store_ps(dst, value); }
+    static void Store(int32_t* const dst, const Int value) { _mm256_store_si256(reinterpret_cast<Int*>(dst), value); }
+};
+
+#include "fragment_simd.inl"
+#include "vertex_simd.inl"
+
+template bool Renderer::DrawBlockSimd<Avx2Lanes>(const TriangleSetup& setup, Tile& tile, const int32_t blockX,
+    const int32_t blockY, const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3],
+    const bool inside);
+
+template void Renderer::TransformVerticesSimd<Avx2Lanes>(const Matrix4x4& mvp, const Vertex* const vertices,
+    const uint32_t* const list, const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const;
+
+#endif
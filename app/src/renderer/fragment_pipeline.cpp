@@ -0,0 +1,240 @@
+#include "renderer/renderer.h"
+
+// Fragment pipelines specialized on the render state of a draw : every combination of texturing, blending,
+// stencil and lighting gets its own copy of the pixel loop, with the state tested at compile time
+
+template <bool TestCoverage, StencilMode StencilTest, Renderer::FinishFragmentFunc Finish>
+void Renderer::DrawBlock(const TriangleSetup& setup, Tile& tile,
+    const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3])
+{
+    const int64_t* const stepX = setup.stepX;
+    const int64_t* const stepY = setup.stepY;
+    const uint32_t nbrPlanes = PLANE_VARYINGS + m_NbrVaryings;
+
+    int64_t edgeRow[3] = { edge[0], edge[1], edge[2] };
+
+    // Interpolated values at the first pixel of the block, only stepped from there on
+    float planeRow[MAX_PLANES];
+    for (uint32_t i = 0; i < nbrPlanes; i++)
+        planeRow[i] = setup.planeBase[i] + setup.planeStepX[i] * (x0 - setup.minX) + setup.planeStepY[i] * (y0 - setup.minY);
+
+    if (TestCoverage)
+        tile.nbrPixelsTested += (x1 - x0 + 1) * (y1 - y0 + 1);
+
+    for (int32_t y = y0; y <= y1; y++)
+    {
+        int64_t e0 = edgeRow[0];
+        int64_t e1 = edgeRow[1];
+        int64_t e2 = edgeRow[2];
+
+        edgeRow[0] += stepY[0];
+        edgeRow[1] += stepY[1];
+        edgeRow[2] += stepY[2];
+
+        float planes[MAX_PLANES];
+        for (uint32_t i = 0; i < nbrPlanes; i++)
+        {
+            planes[i] = planeRow[i];
+            planeRow[i] += setup.planeStepY[i];
+        }
+
+        for (int32_t x = x0; x <= x1; x++, e0 += stepX[0], e1 += stepX[1], e2 += stepX[2])
+        {
+            // If any edge function is negative, then that means the pixel is outside the triangle
+            if (!TestCoverage || (e0 | e1 | e2) >= 0)
+            {
+                if (ShadeFragment<StencilTest, Finish>(setup, x, y, planes))
+                    tile.nbrPixelsShaded++;
+            }
+
+            for (uint32_t i = 0; i < nbrPlanes; i++)
+                planes[i] += setup.planeStepX[i];
+        }
+    }
+}
+
+template <StencilMode StencilTest, Renderer::FinishFragmentFunc Finish>
+bool Renderer::ShadeFragment(const TriangleSetup& setup, const int32_t x, const int32_t y, const float planes[MAX_PLANES])
+{
+    const float depth = planes[PLANE_DEPTH];
+
+    const uint32_t offset = GetPixelOffset(x, y);
+
+    // The stencil is tested first, so that the fragments it rejects are neither shaded nor write their depth
+    if constexpr (StencilTest == StencilMode::TEST)
+    {
+        if (!m_Stencil.Test(offset))
+            return false;
+    }
+
+    if (!TestDepth(offset, depth))
+    {
+        if constexpr (StencilTest == StencilMode::TEST)
+            m_Stencil.ApplyDepthFail(offset);
+
+        return false;
+    }
+
+    if constexpr (StencilTest == StencilMode::TEST)
+        m_Stencil.ApplyDepthPass(offset);
+
+    if (m_DeferredDraw)
+    {
+        // Shaded when the visibility buffer is resolved, if nothing ends up in front of it
+        m_VisibilityBuffer[offset] = setup.id;
+        return false;
+    }
+
+    // Perspective correction : the varyings were divided by w, which 1/w undoes
+    const float w = 1.f / planes[PLANE_INV_W];
+
+    float varyings[MAX_VARYINGS];
+    for (uint32_t i = 0; i < m_NbrVaryings; i++)
+        varyings[i] = planes[PLANE_VARYINGS + i] * w;
+
+    return (this->*Finish)(setup, x, y, depth, varyings);
+}
+
+template <TextureMode Texturing, BlendMode Blend, LightMode Lighting>
+bool Renderer::FinishSpecializedFragment(const TriangleSetup& setup, const int32_t x, const int32_t y,
+    const float depth, const float varyings[MAX_VARYINGS])
+{
+    const uint32_t offset = GetPixelOffset(x, y);
+
+    Vector4 color = ComputeSpecializedColor<Texturing, Lighting>(setup, x, y, depth, varyings,
+        m_CurrentTexture, CurrentMaterial);
+
+    // The destination is only read, and converted back from the color format, when blending
+    if constexpr (Blend != BlendMode::NONE)
+    {
+        const Vector4 dst = LoadColor(offset);
+
+        if constexpr (Blend == BlendMode::ALPHA)
+            color = color * color.w + dst * (1.f - color.w);
+        else if constexpr (Blend == BlendMode::ADDITIVE)
+            color = color + dst;
+        else if constexpr (Blend == BlendMode::MULTIPLY)
+            color = color * dst;
+        else if constexpr (Blend == BlendMode::GENERIC)
+            color = m_Blending.ComputeBlending(dst, color);
+    }
+
+    StoreColor(offset, color);
+    return true;
+}
+
+template <TextureMode Texturing, LightMode Lighting>
+Vector4 Renderer::ComputeSpecializedColor(const TriangleSetup& setup, const int32_t x, const int32_t y,
+    const float depth, const float varyings[MAX_VARYINGS], const int32_t texture, const Material& material)
+{
+    Vector4 color = Vector4(
+        varyings[VARYING_COLOR + 0],
+        varyings[VARYING_COLOR + 1],
+        varyings[VARYING_COLOR + 2],
+        varyings[VARYING_COLOR + 3]
+    );
+
+    if constexpr (Texturing != TextureMode::NONE)
+    {
+        constexpr TexFiltering filtering = Texturing == TextureMode::LINEAR ? TexFiltering::LINEAR : TexFiltering::NEAREST;
+
+        const Vector2 uv = Vector2(varyings[VARYING_UV + 0], varyings[VARYING_UV + 1]);
+        color *= m_Textures[texture].SampleTexel<filtering>(uv);
+    }
+
+    if constexpr (Lighting == LightMode::ONE)
+    {
+        color *= ComputeLight(*m_ActiveLights[0], Vector3(x, y, depth), setup.normal, material);
+    }
+    else if constexpr (Lighting == LightMode::MANY)
+    {
+        const Vector3 position = Vector3(x, y, depth);
+
+        for (const Light* const light : m_ActiveLights)
+            color *= ComputeLight(*light, position, setup.normal, material);
+    }
+
+    return color;
+}
+
+template <uint32_t Key>
+constexpr Renderer::FragmentPipeline Renderer::CreateFragmentPipeline()
+{
+    // Keys enumerate the texture modes first, then the blend modes, the stencil modes and the light modes
+    constexpr uint32_t nbrTextureModes = static_cast<uint32_t>(TextureMode::COUNT);
+    constexpr uint32_t nbrBlendModes = static_cast<uint32_t>(BlendMode::COUNT);
+    constexpr uint32_t nbrStencilModes = static_cast<uint32_t>(StencilMode::COUNT);
+
+    constexpr TextureMode texturing = static_cast<TextureMode>(Key % nbrTextureModes);
+    constexpr BlendMode blend = static_cast<BlendMode>(Key / nbrTextureModes % nbrBlendModes);
+    constexpr StencilMode stencil = static_cast<StencilMode>(Key / (nbrTextureModes * nbrBlendModes) % nbrStencilModes);
+    constexpr LightMode lighting = static_cast<LightMode>(Key / (nbrTextureModes * nbrBlendModes * nbrStencilModes));
+
+    constexpr FinishFragmentFunc finish = &Renderer::FinishSpecializedFragment<texturing, blend, lighting>;
+
+    return {
+        { &Renderer::DrawBlock<false, stencil, finish>, &Renderer::DrawBlock<true, stencil, finish> },
+        finish,
+        &Renderer::ComputeSpecializedColor<texturing, lighting>
+    };
+}
+
+template <uint32_t... Keys>
+constexpr std::array<Renderer::FragmentPipeline, sizeof...(Keys)> Renderer::CreateFragmentPipelines(
+    std::integer_sequence<uint32_t, Keys...>)
+{
+    return { CreateFragmentPipeline<Keys>()... };
+}
+
+void Renderer::UpdateActiveLights()
+{
+    m_ActiveLights.clear();
+    for (const Light& light : m_Lights)
+    {
+        if (light.Enabled)
+            m_ActiveLights.push_back(&light);
+    }
+}
+
+const Renderer::FragmentPipeline& Renderer::GetFragmentPipeline(const int32_t texture, const BlendMode blend,
+    const StencilMode stencil) const
+{
+    // The stencil test comes before the depth test, so even the generic pipelines have a version with it
+    static const FragmentPipeline genericPipelines[] = {
+        {
+            { &Renderer::DrawBlock<false, StencilMode::NONE, &Renderer::FinishFragment>,
+              &Renderer::DrawBlock<true, StencilMode::NONE, &Renderer::FinishFragment> },
+            &Renderer::FinishFragment,
+            &Renderer::ComputeFragmentColor
+        },
+        {
+            { &Renderer::DrawBlock<false, StencilMode::TEST, &Renderer::FinishFragment>,
+              &Renderer::DrawBlock<true, StencilMode::TEST, &Renderer::FinishFragment> },
+            &Renderer::FinishFragment,
+            &Renderer::ComputeFragmentColor
+        }
+    };
+
+    static const std::array<FragmentPipeline, NBR_FRAGMENT_PIPELINES> pipelines =
+        CreateFragmentPipelines(std::make_integer_sequence<uint32_t, NBR_FRAGMENT_PIPELINES>());
+
+    if (!m_SpecializedFragments)
+        return genericPipelines[static_cast<uint32_t>(stencil)];
+
+    TextureMode texturing = TextureMode::NONE;
+    if (texture != -1)
+        texturing = m_Textures[texture].GetFiltering() == TexFiltering::LINEAR ? TextureMode::LINEAR : TextureMode::NEAREST;
+
+    // A single light is common enough to be worth its own pipelines, without the loop
+    LightMode lighting = LightMode::NONE;
+    if (m_ActiveLights.size() == 1)
+        lighting = LightMode::ONE;
+    else if (m_ActiveLights.size() > 1)
+        lighting = LightMode::MANY;
+
+    const uint32_t key = static_cast<uint32_t>(texturing) + static_cast<uint32_t>(TextureMode::COUNT) * (
+        static_cast<uint32_t>(blend) + static_cast<uint32_t>(BlendMode::COUNT) * (
+        static_cast<uint32_t>(stencil) + static_cast<uint32_t>(StencilMode::COUNT) * static_cast<uint32_t>(lighting)));
+
+    return pipelines[key];
+}
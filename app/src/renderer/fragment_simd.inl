@@ -0,0 +1,313 @@
+// Vectorized fragment path, included by the translation units compiled for a given instruction set
+// Lanes wraps the intrinsics of that instruction set, each group of lanes covers 2 rows of Lanes::SizeX pixels,
+// which are consecutive in memory with the tiled layout, the lanes then following the Morton order of the pixels
+// Only intrinsics and plain arithmetic are used here : any inline function of a shared header instantiated
+// in these translation units could end up being the one picked by the linker, and wouldn't run on older CPUs
+
+// Edge functions are evaluated on 32 bits lanes, so blocks whose values could go past this are left to the scalar path
+#define SIMD_EDGE_LIMIT (1ll << 30)
+
+// Planes interpolated in the lanes : depth, 1/w, color and uvs, so that they can stay in registers
+#define SIMD_PLANES (PLANE_VARYINGS + NBR_VERTEX_VARYINGS)
+
+template <typename Lanes>
+bool Renderer::DrawBlockSimd(const TriangleSetup& setup, Tile& tile, const int32_t blockX, const int32_t blockY,
+    const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3], const bool inside)
+{
+    typedef typename Lanes::Float Float;
+    typedef typename Lanes::Int Int;
+
+    // Move the edge functions to the center of the first pixel of the aligned block
+    bool testEdge[3];
+    Int edgeBase[3];
+    Int edgeStepX[3];
+    Int edgeStepY[3];
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const int64_t base = edge[i] - setup.stepX[i] * (x0 - blockX) - setup.stepY[i] * (y0 - blockY);
+
+        const int64_t acrossX = setup.stepX[i] * (BLOCK_SIZE - 1);
+        const int64_t acrossY = setup.stepY[i] * (BLOCK_SIZE - 1);
+        const int64_t lowest = base + (acrossX < 0 ? acrossX : 0) + (acrossY < 0 ? acrossY : 0);
+        const int64_t highest = base + (acrossX > 0 ? acrossX : 0) + (acrossY > 0 ? acrossY : 0);
+
+        // Edges the whole block is inside of don't need to be tested
+        testEdge[i] = !inside && lowest < 0;
+        if (testEdge[i])
+        {
+            if (lowest < -SIMD_EDGE_LIMIT || highest > SIMD_EDGE_LIMIT)
+                return false;
+
+            edgeBase[i] = Lanes::SetInt(static_cast<int32_t>(base));
+            edgeStepX[i] = Lanes::SetInt(static_cast<int32_t>(setup.stepX[i]));
+            edgeStepY[i] = Lanes::SetInt(static_cast<int32_t>(setup.stepY[i]));
+        }
+    }
+
+    // Plane equations moved to the first pixel of the aligned block
+    Float planeBase[SIMD_PLANES];
+    Float planeStepX[SIMD_PLANES];
+    Float planeStepY[SIMD_PLANES];
+
+    for (uint32_t i = 0; i < SIMD_PLANES; i++)
+    {
+        planeBase[i] = Lanes::SetFloat(setup.planeBase[i] + setup.planeStepX[i] * (blockX - setup.minX) +
+            setup.planeStepY[i] * (blockY - setup.minY));
+        planeStepX[i] = Lanes::SetFloat(setup.planeStepX[i]);
+        planeStepY[i] = Lanes::SetFloat(setup.planeStepY[i]);
+    }
+
+    if (!inside)
+        tile.nbrPixelsTested += (x1 - x0 + 1) * (y1 - y0 + 1);
+
+    // Pixels of the aligned block outside of the part of the bounding box being drawn are masked out
+    const Int minLaneX = Lanes::SetInt(x0 - blockX - 1);
+    const Int maxLaneX = Lanes::SetInt(x1 - blockX + 1);
+    const Int minLaneY = Lanes::SetInt(y0 - blockY - 1);
+    const Int maxLaneY = Lanes::SetInt(y1 - blockY + 1);
+    const Int outside = Lanes::SetInt(-1);
+
+    // With the tiled layout the block is a micro-tile, and a group of lanes is loaded at once
+    const bool tiled = m_Layout == FramebufferLayout::TILED;
+    const Int offsetX = tiled ? Lanes::TiledOffsetX() : Lanes::OffsetX();
+    const Int offsetY = tiled ? Lanes::TiledOffsetY() : Lanes::OffsetY();
+    const uint32_t rowStride = tiled ? Lanes::SizeX : m_Width;
+    const uint32_t tileOffset = (blockY / BLOCK_SIZE * m_NbrBlocksX + blockX / BLOCK_SIZE) * BLOCK_SIZE * BLOCK_SIZE;
+
+    alignas(32) int32_t laneOffsetX[Lanes::Count];
+    alignas(32) int32_t laneOffsetY[Lanes::Count];
+    Lanes::Store(laneOffsetX, offsetX);
+    Lanes::Store(laneOffsetY, offsetY);
+
+    const Float zero = Lanes::SetFloat(0.f);
+    const Float one = Lanes::SetFloat(1.f);
+
+    // Normalized depths are quantized the same way as QuantizeDepth, with an exact scaling by a power of 2
+    const uint32_t depthBits = m_DepthFormat == DepthFormat::D16 ? DEPTH16_BITS : DEPTH24_BITS;
+    const Float depthScale = Lanes::SetFloat(static_cast<float>(1u << depthBits));
+    const Int depthMax = Lanes::SetInt(static_cast<int32_t>((1u << depthBits) - 1));
+    const Int stencilMask = Lanes::SetInt(0xff);
+    const Float textureWidth = Lanes::SetFloat(static_cast<float>(m_TextureWidth));
+    const Float textureHeight = Lanes::SetFloat(static_cast<float>(m_TextureHeight));
+    const Float textureMaxX = Lanes::SetFloat(static_cast<float>(m_TextureWidth - 1));
+    const Float textureMaxY = Lanes::SetFloat(static_cast<float>(m_TextureHeight - 1));
+    const Int textureStride = Lanes::SetInt(m_TextureWidth);
+
+    alignas(32) float depths[Lanes::Count];
+    alignas(32) float ws[Lanes::Count];
+    alignas(32) float colors[4][Lanes::Count];
+    float varyings[MAX_VARYINGS];
+    alignas(32) int32_t texels[Lanes::Count];
+
+    for (int32_t groupY = 0; groupY < BLOCK_SIZE; groupY += 2)
+    {
+        for (int32_t groupX = 0; groupX < BLOCK_SIZE; groupX += Lanes::SizeX)
+        {
+            const Int laneX = Lanes::Add(offsetX, Lanes::SetInt(groupX));
+            const Int laneY = Lanes::Add(offsetY, Lanes::SetInt(groupY));
+
+            Int coverage = Lanes::And(
+                Lanes::And(Lanes::Greater(laneX, minLaneX), Lanes::Greater(maxLaneX, laneX)),
+                Lanes::And(Lanes::Greater(laneY, minLaneY), Lanes::Greater(maxLaneY, laneY))
+            );
+
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                if (!testEdge[i])
+                    continue;
+
+                const Int value = Lanes::Add(edgeBase[i],
+                    Lanes::Add(Lanes::Mul(laneX, edgeStepX[i]), Lanes::Mul(laneY, edgeStepY[i])));
+                coverage = Lanes::And(coverage, Lanes::Greater(value, outside));
+            }
+
+            if (Lanes::MoveMask(Lanes::AsFloat(coverage)) == 0)
+                continue;
+
+            // Depth test against the depth buffer
+            const Float fx = Lanes::ToFloat(laneX);
+            const Float fy = Lanes::ToFloat(laneY);
+
+            const Float depth = Lanes::Add(planeBase[PLANE_DEPTH],
+                Lanes::Add(Lanes::Mul(fx, planeStepX[PLANE_DEPTH]), Lanes::Mul(fy, planeStepY[PLANE_DEPTH])));
+
+            // Groups start on even pixels, so their Morton index only has the higher bits
+            const uint32_t groupOffset = tiled ?
+                tileOffset | (groupX & 2) << 1 | (groupY & 2) << 2 | (groupX & 4) << 2 | (groupY & 4) << 3 :
+                ARR_2D_IDX(blockX + groupX, blockY + groupY);
+            int32_t mask;
+
+            if (m_DepthFormat == DepthFormat::D32F)
+            {
+                float* const depthRow = &m_DepthBuffer[groupOffset];
+                const Float previousDepth = Lanes::LoadRows(depthRow, rowStride);
+                const Float pass = Lanes::And(Lanes::AsFloat(coverage), Lanes::Less(depth, previousDepth));
+
+                mask = Lanes::MoveMask(pass);
+                if (mask == 0)
+                    continue;
+
+                Lanes::StoreRows(depthRow, rowStride, Lanes::Select(previousDepth, depth, pass));
+            }
+            else
+            {
+                const Int quantized = Lanes::Min(Lanes::Truncate(Lanes::Mul(Lanes::Min(Lanes::Max(depth, zero), one),
+                    depthScale)), depthMax);
+
+                if (m_DepthFormat == DepthFormat::D16)
+                {
+                    uint16_t* const depthRow = &m_DepthBuffer16[groupOffset];
+                    const Int previousDepth = Lanes::LoadRows(depthRow, rowStride);
+                    const Float pass = Lanes::And(Lanes::AsFloat(coverage), Lanes::AsFloat(Lanes::Greater(previousDepth, quantized)));
+
+                    mask = Lanes::MoveMask(pass);
+                    if (mask == 0)
+                        continue;
+
+                    Lanes::StoreRows(depthRow, rowStride, Lanes::Select(previousDepth, quantized, pass));
+                }
+                else
+                {
+                    // The stencil in the low byte of the words is kept as is
+                    uint32_t* const depthRow = &m_DepthBuffer24[groupOffset];
+                    const Int previousWords = Lanes::LoadRows(depthRow, rowStride);
+                    const Float pass = Lanes::And(Lanes::AsFloat(coverage),
+                        Lanes::AsFloat(Lanes::Greater(Lanes::ShiftRight(previousWords, 8), quantized)));
+
+                    mask = Lanes::MoveMask(pass);
+                    if (mask == 0)
+                        continue;
+
+                    const Int words = Lanes::Or(Lanes::ShiftLeft(quantized, 8), Lanes::And(previousWords, stencilMask));
+                    Lanes::StoreRows(depthRow, rowStride, Lanes::Select(previousWords, words, pass));
+                }
+            }
+
+            if (m_DeferredDraw)
+            {
+                // Shaded when the visibility buffer is resolved
+                for (int32_t lane = 0; lane < Lanes::Count; lane++)
+                {
+                    if ((mask & (1 << lane)) != 0)
+                    {
+                        const uint32_t offset = tiled ? groupOffset + lane :
+                            ARR_2D_IDX(blockX + groupX + laneOffsetX[lane], blockY + groupY + laneOffsetY[lane]);
+                        m_VisibilityBuffer[offset] = setup.id;
+                    }
+                }
+
+                continue;
+            }
+
+            // Perspective correction : the varyings were divided by w, which 1/w undoes
+            const Float invW = Lanes::Add(planeBase[PLANE_INV_W],
+                Lanes::Add(Lanes::Mul(fx, planeStepX[PLANE_INV_W]), Lanes::Mul(fy, planeStepY[PLANE_INV_W])));
+            const Float w = Lanes::Div(Lanes::SetFloat(1.f), invW);
+
+            if (!m_FastFragments)
+            {
+                // Lights or blending are involved, finish each fragment with the scalar path
+                Lanes::Store(depths, depth);
+                Lanes::Store(ws, w);
+
+                for (int32_t lane = 0; lane < Lanes::Count; lane++)
+                {
+                    if ((mask & (1 << lane)) == 0)
+                        continue;
+
+                    const int32_t x = blockX + groupX + laneOffsetX[lane];
+                    const int32_t y = blockY + groupY + laneOffsetY[lane];
+
+                    for (uint32_t i = 0; i < m_NbrVaryings; i++)
+                    {
+                        const uint32_t plane = PLANE_VARYINGS + i;
+                        varyings[i] = (setup.planeBase[plane] + setup.planeStepX[plane] * (x - setup.minX) +
+                            setup.planeStepY[plane] * (y - setup.minY)) * ws[lane];
+                    }
+
+                    if ((this->*m_Pipeline.finishFragment)(setup, x, y, depths[lane], varyings))
+                        tile.nbrPixelsShaded++;
+                }
+
+                continue;
+            }
+
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                const uint32_t plane = PLANE_VARYINGS + VARYING_COLOR + i;
+                Lanes::Store(colors[i], Lanes::Mul(w, Lanes::Add(planeBase[plane],
+                    Lanes::Add(Lanes::Mul(fx, planeStepX[plane]), Lanes::Mul(fy, planeStepY[plane])))));
+            }
+
+            if (m_TextureData != nullptr)
+            {
+                // Get the offset of the texel, the same way Texture::SampleTexel does
+                const uint32_t planeU = PLANE_VARYINGS + VARYING_UV;
+                const uint32_t planeV = PLANE_VARYINGS + VARYING_UV + 1;
+                const Float u = Lanes::Mul(w, Lanes::Add(planeBase[planeU],
+                    Lanes::Add(Lanes::Mul(fx, planeStepX[planeU]), Lanes::Mul(fy, planeStepY[planeU]))));
+                const Float v = Lanes::Mul(w, Lanes::Add(planeBase[planeV],
+                    Lanes::Add(Lanes::Mul(fx, planeStepX[planeV]), Lanes::Mul(fy, planeStepY[planeV]))));
+
+                const Float texX = Lanes::Min(Lanes::Max(Lanes::Mul(u, textureWidth), zero), textureMaxX);
+                const Float texY = Lanes::Min(Lanes::Max(Lanes::Mul(v, textureHeight), zero), textureMaxY);
+
+                Lanes::Store(texels, Lanes::Add(Lanes::Mul(Lanes::Truncate(texY), textureStride), Lanes::Truncate(texX)));
+            }
+
+            for (int32_t lane = 0; lane < Lanes::Count; lane++)
+            {
+                if ((mask & (1 << lane)) == 0)
+                    continue;
+
+
+                float r = colors[0][lane];
+                float g = colors[1][lane];
+                float b = colors[2][lane];
+                float a = colors[3][lane];
+                if (m_TextureData != nullptr)
+                {
+                    const Vector4& texel = m_TextureData[texels[lane]];
+
+                    r *= texel.x;
+                    g *= texel.y;
+                    b *= texel.z;
+                    a *= texel.w;
+                }
+
+                // Same conversions as StoreColor, which can't be called from here
+                const uint32_t offset = tiled ? groupOffset + lane :
+                    ARR_2D_IDX(blockX + groupX + laneOffsetX[lane], blockY + groupY + laneOffsetY[lane]);
+                if (m_ColorFormat == ColorFormat::RGBA32F)
+                {
+                    Vector4& dst = m_ColorBuffer[offset];
+                    dst.x = r;
+                    dst.y = g;
+                    dst.z = b;
+                    dst.w = a;
+                }
+                else if (m_ColorFormat == ColorFormat::RGBA8)
+                {
+                    r = r < 0.f ? 0.f : (r > 1.f ? 1.f : r);
+                    g = g < 0.f ? 0.f : (g > 1.f ? 1.f : g);
+                    b = b < 0.f ? 0.f : (b > 1.f ? 1.f : b);
+                    a = a < 0.f ? 0.f : (a > 1.f ? 1.f : a);
+
+                    m_ColorBuffer8[offset] = static_cast<uint32_t>(r * 255.f + .5f) |
+                        static_cast<uint32_t>(g * 255.f + .5f) << 8 |
+                        static_cast<uint32_t>(b * 255.f + .5f) << 16 |
+                        static_cast<uint32_t>(a * 255.f + .5f) << 24;
+                }
+                else
+                {
+                    WriteColor(offset, r, g, b, a);
+                }
+
+                tile.nbrPixelsShaded++;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "renderer/renderer.h"
+
+// Compiled with SSE4.1 enabled, only called when the CPU supports it
+#ifdef RENDERER_SIMD_X86
+
+#include <smmintrin.h>
+
+struct Sse4Lanes
+{
+    typedef __m128 Float;
+    typedef __m128i Int;
+
+    // 2x2 quad
+    static constexpr int32_t Count = 4;
+    static constexpr int32_t SizeX = 2;
+
+    static Float SetFloat(const float value) { return _mm_set1_ps(value); }
+    static Int SetInt(const int32_t value) { return _mm_set1_epi32(value); }
+
+    static Int OffsetX() { return _mm_setr_epi32(0, 1, 0, 1); }
+    static Int OffsetY() { return _mm_setr_epi32(0, 0, 1, 1); }
+
+    // Morton order of the tiled layout, which is the same for a quad
+    static Int TiledOffsetX() { return _mm_setr_epi32(0, 1, 0, 1); }
+    static Int TiledOffsetY() { return _mm_setr_epi32(0, 0, 1, 1); }
+
+    static Float ToFloat(const Int a) { return _mm_cvtepi32_ps(a); }
+    static Int Truncate(const Float a) { return _mm_cvttps_epi32(a); }
+    static Float AsFloat(const Int a) { return _mm_castsi128_ps(a); }
+
+    static Int Add(const Int a, const Int b) { return _mm_add_epi32(a, b); }
+    static Int Mul(const Int a, const Int b) { return _mm_mullo_epi32(a, b); }
+    static Int And(const Int a, const Int b) { return _mm_and_si128(a, b); }
+    static Int Greater(const Int a, const Int b) { return _mm_cmpgt_epi32(a, b); }
+
+    static Float Add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+    static Float Mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+    static Float Div(const Float a, const Float b) { return _mm_div_ps(a, b); }
+    static Float Min(const Float a, const Float b) { return _mm_min_ps(a, b); }
+    static Float Max(const Float a, const Float b) { return _mm_max_ps(a, b); }
+    static Float And(const Float a, const Float b) { return _mm_and_ps(a, b); }
+    static Float Less(const Float a, const Float b) { return _mm_cmplt_ps(a, b); }
+    static Float Select(const Float a, const Float b, const Float mask) { return _mm_blendv_ps(a, b, mask); }
+    static int32_t MoveMask(const Float a) { return _mm_movemask_ps(a); }
+
+    static Float LoadRows(const float* const row, const uint32_t stride)
+    {
+        const Float low = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(row)));
+        return _mm_loadh_pi(low, reinterpret_cast<const __m64*>(row + stride));
+    }
+
+    static void StoreRows(float* const row, const uint32_t stride, const Float value)
+    {
+        _mm_storel_pi(reinterpret_cast<__m64*>(row), value);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(row + stride), value);
+    }
+
+    static Int Or(const Int a, const Int b) { return _mm_or_si128(a, b); }
+    static Int Min(const Int a, const Int b) { return _mm_min_epi32(a, b); }
+    static Int ShiftLeft(const Int a, const int32_t bits) { return _mm_slli_epi32(a, bits); }
+    static Int ShiftRight(const Int a, const int32_t bits) { return _mm_srli_epi32(a, bits); }
+    static Int Select(const Int a, const Int b, const Float mask)
+    {
+        return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), mask));
+    }
+
+    // Rows of normalized depths, widened to 32 bits
+    static Int LoadRows(const uint16_t* const row, const uint32_t stride)
+    {
+        return _mm_cvtepu16_epi32(_mm_unpacklo_epi32(_mm_loadu_si32(row), _mm_loadu_si32(row + stride)));
+    }
+
+    static void StoreRows(uint16_t* const row, const uint32_t stride, const Int value)
+    {
+        const Int packed = _mm_packus_epi32(value, value);
+        _mm_storeu_si32(row, packed);
+        _mm_storeu_si32(row + stride, _mm_srli_si128(packed, 4));
+    }
+
+    static Int LoadRows(const uint32_t* const row, const uint32_t stride)
+    {
+        return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const Int*>(row)),
+            _mm_loadl_epi64(reinterpret_cast<const Int*>(row + stride)));
+    }
+
+    static void StoreRows(uint32_t* const row, const uint32_t stride, const Int value)
+    {
+        _mm_storel_epi64(reinterpret_cast<Int*>(row), value);
+        _mm_storel_epi64(reinterpret_cast<Int*>(row + stride), _mm_unpackhi_epi64(value, value));
+    }
+
+    static Float Load(const float* const src) { return _mm_load_ps(src); }
+    static void Store(float* const dst, const Float value) { _mm_store_ps(dst, value); }
+    static void Store(int32_t* const dst, const Int value) { _mm_store_si128(reinterpret_cast<Int*>(dst), value); }
+};
+
+#include "fragment_simd.inl"
+#include "vertex_simd.inl"
+
+template bool Renderer::DrawBlockSimd<Sse4Lanes>(const TriangleSetup& setup, Tile& tile, const int32_t blockX,
+    const int32_t blockY, const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1, const int64_t edge[3],
+    const bool inside);
+
+template void Renderer::TransformVerticesSimd<Sse4Lanes>(const Matrix4x4& mvp, const Vertex* const vertices,
+    const uint32_t* const list, const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const;
+
+#endif
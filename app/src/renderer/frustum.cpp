@@ -0,0 +1,72 @@
+#include "renderer/frustum.h"
+
+#include <cmath>
+
+void Frustum::Extract(const Matrix4x4& viewProjection)
+{
+	// Clip space points are inside when -w <= x, y, z <= w, so each plane is the last row plus or minus another
+	const Vector4 row3 = viewProjection[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const Vector4 row = viewProjection[i];
+
+		Planes[i * 2 + 0] = Vector4(row3.x + row.x, row3.y + row.y, row3.z + row.z, row3.w + row.w);
+		Planes[i * 2 + 1] = Vector4(row3.x - row.x, row3.y - row.y, row3.z - row.z, row3.w - row.w);
+	}
+
+	// Normalized so that the planes give distances, which the sphere test needs
+	for (Vector4& plane : Planes)
+	{
+		const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.f)
+			plane = Vector4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+	}
+}
+
+bool Frustum::IntersectsSphere(const Vector3& center, const float radius, bool& inside) const
+{
+	inside = true;
+
+	for (const Vector4& plane : Planes)
+	{
+		const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		if (distance < -radius)
+			return false;
+
+		if (distance < radius)
+			inside = false;
+	}
+
+	return true;
+}
+
+bool Frustum::IntersectsBox(const Vector3& center, const Vector3& extents) const
+{
+	for (const Vector4& plane : Planes)
+	{
+		const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		const float reach = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+		if (distance < -reach)
+			return false;
+	}
+
+	return true;
+}
+
+Containment Frustum::ClassifyBox(const Vector3& center, const Vector3& extents) const
+{
+	Containment result = Containment::INSIDE;
+
+	for (const Vector4& plane : Planes)
+	{
+		const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		const float reach = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+		if (distance < -reach)
+			return Containment::OUTSIDE;
+
+		if (distance < reach)
+			result = Containment::INTERSECTS;
+	}
+
+	return result;
+}
@@ -0,0 +1,215 @@
+#include "renderer/occlusion.h"
+#include "renderer/simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef RENDERER_SIMD_X86
+// SSE2 is part of x86-64, so the occlusion buffer doesn't need a path selected at runtime
+#include <emmintrin.h>
+#endif
+
+// Triangles smaller than this, in pixels of the occlusion buffer, are skipped
+#define MIN_OCCLUDER_AREA 1e-3f
+
+OcclusionBuffer::OcclusionBuffer()
+	: m_Depths(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.f)
+{
+}
+
+void OcclusionBuffer::Clear()
+{
+	std::fill(m_Depths.begin(), m_Depths.end(), 1.f);
+}
+
+void OcclusionBuffer::DrawOccluder(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const Matrix4x4& mvp)
+{
+	Matrix4x4 transform = mvp;
+
+	m_ClipPositions.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vector3& position = vertices[i].m_Position;
+		m_ClipPositions[i] = transform.Multiply(Vector4(position.x, position.y, position.z, 1.f));
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		DrawTriangle(m_ClipPositions[indices[i + 0]], m_ClipPositions[indices[i + 1]], m_ClipPositions[indices[i + 2]]);
+}
+
+void OcclusionBuffer::DrawTriangle(const Vector4& clip0, const Vector4& clip1, const Vector4& clip2)
+{
+	// Not clipping only makes the occluders smaller
+	const Vector4* const clips[3] = { &clip0, &clip1, &clip2 };
+	for (const Vector4* const clip : clips)
+	{
+		if (clip->w <= 0.f || clip->z < -clip->w)
+			return;
+	}
+
+	float x[3];
+	float y[3];
+	float z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const float inverseW = 1.f / clips[i]->w;
+
+		x[i] = (clips[i]->x * inverseW + 1.f) * .5f * OCCLUSION_WIDTH;
+		y[i] = (clips[i]->y * inverseW + 1.f) * .5f * OCCLUSION_HEIGHT;
+		z[i] = clips[i]->z * inverseW;
+	}
+
+	// Both sides of the occluders hide what's behind them, the vertices are swapped to face the same way
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (std::abs(area) < MIN_OCCLUDER_AREA)
+		return;
+
+	if (area < 0.f)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(z[1], z[2]);
+		area = -area;
+	}
+
+	const int32_t minX = std::max(static_cast<int32_t>(std::floor(std::min({ x[0], x[1], x[2] }))), 0) & ~3;
+	const int32_t maxX = std::min(static_cast<int32_t>(std::ceil(std::max({ x[0], x[1], x[2] }))), OCCLUSION_WIDTH - 1);
+	const int32_t minY = std::max(static_cast<int32_t>(std::floor(std::min({ y[0], y[1], y[2] }))), 0);
+	const int32_t maxY = std::min(static_cast<int32_t>(std::ceil(std::max({ y[0], y[1], y[2] }))), OCCLUSION_HEIGHT - 1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// Edge functions a * x + b * y + c, positive inside. Pixels are covered when their center is inside or on an edge,
+	// so that the triangles sharing an edge don't leave a crack between them
+	float a[3];
+	float b[3];
+	float c[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+
+		a[i] = y[i] - y[j];
+		b[i] = x[j] - x[i];
+		c[i] = x[i] * y[j] - x[j] * y[i];
+	}
+
+	// Depth plane, moved to the farthest corner of each pixel, and never farther than the triangle
+	const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	const float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	const float z0 = z[0] - dzdx * x[0] - dzdy * y[0] + .5f * (std::abs(dzdx) + std::abs(dzdy));
+	const float maxZ = std::max({ z[0], z[1], z[2] });
+
+	for (int32_t py = minY; py <= maxY; py++)
+	{
+		const float centerY = py + .5f;
+		float* const row = m_Depths.data() + py * OCCLUSION_WIDTH;
+
+#ifdef RENDERER_SIMD_X86
+		const __m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, .5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 farthest = _mm_set1_ps(maxZ);
+
+		for (int32_t px = minX; px <= maxX; px += 4)
+		{
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), stepX);
+
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), centerX), _mm_set1_ps(b[0] * centerY + c[0])), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), centerX), _mm_set1_ps(b[1] * centerY + c[1])), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), centerX), _mm_set1_ps(b[2] * centerY + c[2])), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			const __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), centerX), _mm_set1_ps(dzdy * centerY + z0)), farthest);
+
+			// The vector only aligns the depths on floats, so they're loaded and stored unaligned
+			const __m128 old = _mm_loadu_ps(row + px);
+			const __m128 closest = _mm_min_ps(old, depth);
+			_mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, old)));
+		}
+#else
+		for (int32_t px = minX; px <= maxX; px++)
+		{
+			const float centerX = px + .5f;
+			if (a[0] * centerX + b[0] * centerY + c[0] < 0.f || a[1] * centerX + b[1] * centerY + c[1] < 0.f ||
+				a[2] * centerX + b[2] * centerY + c[2] < 0.f)
+				continue;
+
+			const float depth = std::min(dzdx * centerX + dzdy * centerY + z0, maxZ);
+			row[px] = std::min(row[px], depth);
+		}
+#endif
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const Bounds& bounds, const Matrix4x4& mvp) const
+{
+	Matrix4x4 transform = mvp;
+
+	float minX = INFINITY;
+	float minY = INFINITY;
+	float maxX = -INFINITY;
+	float maxY = -INFINITY;
+	float minZ = INFINITY;
+
+	for (int i = 0; i < 8; i++)
+	{
+		const Vector4 corner = Vector4(
+			i & 1 ? bounds.Max.x : bounds.Min.x,
+			i & 2 ? bounds.Max.y : bounds.Min.y,
+			i & 4 ? bounds.Max.z : bounds.Min.z,
+			1.f
+		);
+
+		// Boxes crossing the near plane cover the camera, they can't be behind anything
+		const Vector4 clip = transform.Multiply(corner);
+		if (clip.w <= 0.f || clip.z < -clip.w)
+			return false;
+
+		const float inverseW = 1.f / clip.w;
+		minX = std::min(minX, clip.x * inverseW);
+		maxX = std::max(maxX, clip.x * inverseW);
+		minY = std::min(minY, clip.y * inverseW);
+		maxY = std::max(maxY, clip.y * inverseW);
+		minZ = std::min(minZ, clip.z * inverseW);
+	}
+
+	// Every pixel the rectangle touches, even partially, and their neighbours : the occluders only cover the pixels
+	// whose center they're over, so the object could still be seen in the pixels next to their silhouette
+	const int32_t firstX = std::max(static_cast<int32_t>(std::floor((minX + 1.f) * .5f * OCCLUSION_WIDTH)) - 1, 0);
+	const int32_t lastX = std::min(static_cast<int32_t>(std::floor((maxX + 1.f) * .5f * OCCLUSION_WIDTH)) + 1, OCCLUSION_WIDTH - 1);
+	const int32_t firstY = std::max(static_cast<int32_t>(std::floor((minY + 1.f) * .5f * OCCLUSION_HEIGHT)) - 1, 0);
+	const int32_t lastY = std::min(static_cast<int32_t>(std::floor((maxY + 1.f) * .5f * OCCLUSION_HEIGHT)) + 1, OCCLUSION_HEIGHT - 1);
+	if (firstX > lastX || firstY > lastY)
+		return false;
+
+	for (int32_t py = firstY; py <= lastY; py++)
+	{
+		const float* const row = m_Depths.data() + py * OCCLUSION_WIDTH;
+
+#ifdef RENDERER_SIMD_X86
+		const __m128i first = _mm_set1_epi32(firstX - 1);
+		const __m128i last = _mm_set1_epi32(lastX + 1);
+		const __m128 depth = _mm_set1_ps(minZ);
+
+		for (int32_t px = firstX & ~3; px <= lastX; px += 4)
+		{
+			const __m128i lanes = _mm_add_epi32(_mm_set1_epi32(px), _mm_set_epi32(3, 2, 1, 0));
+			const __m128 inRect = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(lanes, first), _mm_cmplt_epi32(lanes, last)));
+
+			// Visible as soon as one pixel has no occluder in front of the box
+			const __m128 visible = _mm_and_ps(inRect, _mm_cmpge_ps(_mm_loadu_ps(row + px), depth));
+			if (_mm_movemask_ps(visible) != 0)
+				return false;
+		}
+#else
+		for (int32_t px = firstX; px <= lastX; px++)
+		{
+			if (row[px] >= minZ)
+				return false;
+		}
+#endif
+	}
+
+	return true;
+}
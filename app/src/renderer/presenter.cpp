@@ -0,0 +1,114 @@
+#include "renderer/presenter.h"
+
+#include <chrono>
+
+#define PRESENT_NONE -1
+
+Presenter::Presenter(const uint32_t nbrTargets, const size_t stagingSize, const ConvertFunc& convert)
+	: m_Convert(convert), m_Queued(PRESENT_NONE), m_Converting(PRESENT_NONE), m_Latest(PRESENT_NONE),
+	m_HasNewFrame(false), m_ConvertTime(0.0), m_Stopping(false)
+{
+	m_Stagings.resize(nbrTargets);
+	for (std::vector<uint8_t>& staging : m_Stagings)
+		staging.resize(stagingSize);
+
+	m_Thread = std::thread(&Presenter::PresentLoop, this);
+}
+
+Presenter::~Presenter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+
+	m_WakeUp.notify_all();
+	m_Thread.join();
+}
+
+void Presenter::Present(const uint32_t target)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	// A single frame waits at a time, the renderer doesn't get ahead of the present thread by more than that
+	m_Done.wait(lock, [this]() { return m_Queued == PRESENT_NONE; });
+	m_Queued = static_cast<int32_t>(target);
+
+	lock.unlock();
+	m_WakeUp.notify_all();
+}
+
+void Presenter::WaitForTarget(const uint32_t target)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Done.wait(lock, [this, target]()
+		{
+			return m_Queued != static_cast<int32_t>(target) && m_Converting != static_cast<int32_t>(target);
+		});
+}
+
+void Presenter::WaitForIdle()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Done.wait(lock, [this]() { return m_Queued == PRESENT_NONE && m_Converting == PRESENT_NONE; });
+}
+
+const uint8_t* Presenter::AcquireLatestFrame()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (!m_HasNewFrame)
+		return nullptr;
+
+	m_HasNewFrame = false;
+	return m_Stagings[m_Latest].data();
+}
+
+const uint8_t* Presenter::GetLatestFrame()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Latest == PRESENT_NONE ? nullptr : m_Stagings[m_Latest].data();
+}
+
+double Presenter::GetConvertTime()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_ConvertTime;
+}
+
+void Presenter::PresentLoop()
+{
+	using std::chrono::high_resolution_clock;
+
+	while (true)
+	{
+		int32_t target;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeUp.wait(lock, [this]() { return m_Stopping || m_Queued != PRESENT_NONE; });
+
+			if (m_Stopping)
+				return;
+
+			target = m_Queued;
+			m_Converting = target;
+			m_Queued = PRESENT_NONE;
+		}
+
+		// The slot of the queue is free again
+		m_Done.notify_all();
+
+		const high_resolution_clock::time_point start = high_resolution_clock::now();
+		m_Convert(static_cast<uint32_t>(target), m_Stagings[target].data());
+		const double ms = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Converting = PRESENT_NONE;
+			m_Latest = target;
+			m_HasNewFrame = true;
+			m_ConvertTime = ms;
+		}
+
+		m_Done.notify_all();
+	}
+}
@@ -2,15 +2,52 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <iostream>
+#include <chrono>
+#include <atomic>
 
+#ifndef RENDERER_HEADLESS
 #include "ImGui/imgui.h"
 #include "glad/glad.h"
+#endif
 
 #define MAX_AMOUNT_OF_LIGHTS 8
 
+// Screen coordinates are rasterized in 28.4 fixed point
+#define SUBPIXEL_BITS 4
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF (SUBPIXEL_ONE / 2)
+#define MAX_FIXED_COORD ((float)(1 << (31 - SUBPIXEL_BITS - 2)))
+
+// Margin added to the depth range of the triangles, as the interpolated depth can slightly go past
+// the depth of the vertices, the hierarchical depth buffer must never be lower than the depth buffer
+#define HIZ_EPSILON 1e-5f
+
+// Triangles are only clipped against the sides of the frustum once they go past this many times the viewport
+// (in NDC units), as the rasterizer already discards the pixels outside of the viewport. This keeps the screen
+// coordinates small enough for the floats they're computed with to stay precise at the subpixel level
+#define GUARD_BAND 16.f
+
+// Outcodes, a bit is set for each plane a vertex in clip space is outside of
+#define CLIP_LEFT (1 << 0)
+#define CLIP_RIGHT (1 << 1)
+#define CLIP_BOTTOM (1 << 2)
+#define CLIP_TOP (1 << 3)
+#define CLIP_NEAR (1 << 4)
+#define CLIP_FAR (1 << 5)
+#define CLIP_GUARD_LEFT (1 << 6)
+#define CLIP_GUARD_RIGHT (1 << 7)
+#define CLIP_GUARD_BOTTOM (1 << 8)
+#define CLIP_GUARD_TOP (1 << 9)
+#define CLIP_PLANE_COUNT 10
+
+// Planes triangles are actually clipped against
+#define CLIP_PLANES (CLIP_NEAR | CLIP_FAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP)
+
+#ifndef RENDERER_HEADLESS
 void Renderer::CreateFramebuffer()
 {
     glGenTextures(1, &m_TextureId);
@@ -26,24 +63,187 @@ void Renderer::CreateFramebuffer()
 
 void Renderer::UpdateFramebuffer()
 {
+    if (m_Presenter != nullptr)
+    {
+        // The present thread already converted the frame to RGBA8 rows, which are only uploaded once
+        const uint8_t* const pixels = m_Presenter->AcquireLatestFrame();
+        if (pixels == nullptr)
+            return;
+
+        glBindTexture(GL_TEXTURE_2D, m_TextureId);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        return;
+    }
+
+    // The color buffer is uploaded in its format, without converting it first
+    const void* const pixels = GetLinearColorBuffer();
+
     glBindTexture(GL_TEXTURE_2D, m_TextureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_Width, m_Height,
-        0, GL_RGBA, GL_FLOAT, m_ColorBuffer);
+    switch (m_ColorFormat)
+    {
+        case ColorFormat::RGBA16F:
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_HALF_FLOAT, pixels);
+            break;
+
+        case ColorFormat::RGBA8:
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            break;
+
+        default:
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, GL_RGBA, GL_FLOAT, pixels);
+    }
 }
 
 void Renderer::DestroyFramebuffer()
 {
     glDeleteTextures(1, &m_TextureId);
 }
+#else
+// There is no OpenGL context in headless mode, the color buffer is read back with GetPixel instead
+void Renderer::CreateFramebuffer()
+{
+    m_TextureId = 0;
+}
+
+void Renderer::UpdateFramebuffer()
+{
+}
+
+void Renderer::DestroyFramebuffer()
+{
+}
+#endif
+
+const void* Renderer::GetLinearColorBuffer()
+{
+    ResolveClears();
+
+    const uint8_t* const colors = m_ColorFormat == ColorFormat::RGBA16F ? reinterpret_cast<const uint8_t*>(m_ColorBuffer16F) :
+        m_ColorFormat == ColorFormat::RGBA8 ? reinterpret_cast<const uint8_t*>(m_ColorBuffer8) :
+        reinterpret_cast<const uint8_t*>(m_ColorBuffer);
+
+    if (m_Layout == FramebufferLayout::LINEAR)
+        return colors;
+
+    const uint32_t pixelSize = GetColorFormatSize(m_ColorFormat);
+    m_LinearColorBuffer.resize(static_cast<size_t>(m_Width) * m_Height * pixelSize);
+
+    // Pixels are in pairs along the rows of the micro-tiles, which are copied together
+    m_ThreadPool.ParallelFor(m_Height,
+        [this, colors, pixelSize](const uint32_t y)
+        {
+            uint8_t* const row = &m_LinearColorBuffer[static_cast<size_t>(y) * m_Width * pixelSize];
+
+            for (uint32_t x = 0; x < m_Width; x += 2)
+            {
+                const uint32_t count = x + 1 < m_Width ? 2 : 1;
+                std::memcpy(row + x * pixelSize, colors + static_cast<size_t>(GetPixelOffset(x, y)) * pixelSize,
+                    count * pixelSize);
+            }
+        });
+
+    return m_LinearColorBuffer.data();
+}
+
+void Renderer::SelectColorTarget(const uint32_t target)
+{
+    m_ColorTarget = target;
+    m_ColorBuffer = m_ColorTargets[target].color;
+    m_ColorBuffer16F = m_ColorTargets[target].color16F;
+    m_ColorBuffer8 = m_ColorTargets[target].color8;
+}
+
+void Renderer::ConvertColorTarget(const uint32_t target, uint8_t* const staging) const
+{
+    const ColorTarget& colors = m_ColorTargets[target];
+    uint32_t* const pixels = reinterpret_cast<uint32_t*>(staging);
+
+    // The thread pool rasterizes the next frame meanwhile, so the whole frame is converted on this thread
+    for (uint32_t y = 0; y < m_Height; y++)
+    {
+        uint32_t* const row = pixels + static_cast<size_t>(y) * m_Width;
+
+        for (uint32_t x = 0; x < m_Width; x++)
+        {
+            const uint32_t offset = GetPixelOffset(x, y);
+
+            switch (m_ColorFormat)
+            {
+                case ColorFormat::RGBA16F:
+                    row[x] = PackRgba8(UnpackRgba16F(colors.color16F[offset]));
+                    break;
+
+                case ColorFormat::RGBA8:
+                    row[x] = colors.color8[offset];
+                    break;
+
+                default:
+                    row[x] = PackRgba8(colors.color[offset]);
+            }
+        }
+    }
+}
 
 
-Renderer::Renderer(uint32_t width, uint32_t height)
-    : m_Width(width), m_Height(height), Camera(*this), m_Stencil(width, height)
+Renderer::Renderer(uint32_t width, uint32_t height, uint32_t nbrThreads, ColorFormat colorFormat,
+    DepthFormat depthFormat, FramebufferLayout layout, uint32_t nbrColorTargets)
+    : m_Width(width), m_Height(height), m_Layout(layout), m_NbrStoredPixels(GetFramebufferSize(width, height, layout)),
+    m_Stencil(m_NbrStoredPixels), m_ThreadPool(nbrThreads), Camera(*this)
 {
-    m_ColorBuffer = new Vector4[width * height];
-    m_DepthBuffer = new float_t[width * height];
+    const uint32_t nbrPixels = m_NbrStoredPixels;
+
+    m_ColorFormat = colorFormat;
+    m_ColorTargets.resize(std::max(nbrColorTargets, 1u));
+    for (ColorTarget& target : m_ColorTargets)
+    {
+        target.color = colorFormat == ColorFormat::RGBA32F ? new Vector4[nbrPixels] : nullptr;
+        target.color16F = colorFormat == ColorFormat::RGBA16F ? new uint64_t[nbrPixels] : nullptr;
+        target.color8 = colorFormat == ColorFormat::RGBA8 ? new uint32_t[nbrPixels] : nullptr;
+    }
+    SelectColorTarget(0);
+
+    m_Presenter = nullptr;
+    if (m_ColorTargets.size() > 1)
+    {
+        m_Presenter = new Presenter(m_ColorTargets.size(), static_cast<size_t>(width) * height * sizeof(uint32_t),
+            [this](const uint32_t target, uint8_t* const staging)
+            {
+                ConvertColorTarget(target, staging);
+            });
+    }
+
+    m_DepthFormat = depthFormat;
+    m_DepthBuffer = depthFormat == DepthFormat::D32F ? new float_t[nbrPixels] : nullptr;
+    m_DepthBuffer24 = depthFormat == DepthFormat::D24S8 ? new uint32_t[nbrPixels] : nullptr;
+    m_DepthBuffer16 = depthFormat == DepthFormat::D16 ? new uint16_t[nbrPixels] : nullptr;
+
+    // The stencil goes in the low byte of the depth words, which is their first one on little endian CPUs
+    if (depthFormat == DepthFormat::D24S8)
+        m_Stencil.SetStorage(reinterpret_cast<uint8_t*>(m_DepthBuffer24), sizeof(uint32_t));
+
+    m_VisibilityBuffer = new uint32_t[nbrPixels];
+    std::fill(m_VisibilityBuffer, m_VisibilityBuffer + nbrPixels, VISIBILITY_NONE);
+    m_RenderMode = RenderMode::FORWARD;
+    m_CullMode = CullMode::NONE;
+    m_FrontFace = FrontFace::CCW;
+    m_DeferredDraw = false;
+    m_NbrVaryings = NBR_VERTEX_VARYINGS;
+    m_SpecializedFragments = true;
+    m_Pipeline = GetFragmentPipeline(-1, BlendMode::NONE, StencilMode::NONE);
+    m_SkipHiddenFragments = true;
+
+    m_NbrBlocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    m_BlockMaxDepths.resize(m_NbrBlocksX * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE), INFINITY);
+
+    CreateTiles();
+    m_FragmentPath = GetSupportedFragmentPath();
 
     m_FramebufferScale = 1;
+    m_HasViewportClick = false;
+    m_CurrentTexture = -1;
+
+    m_StopTime = false;
+    m_Time = 0.f;
 
     CreateFramebuffer();
     SetClearColor(Vector4(0.0f, 0.0f, 0.0f, 1.0f));
@@ -65,14 +265,56 @@ Renderer::Renderer(uint32_t width, uint32_t height)
     }
 
     // SetLightState(0, true);
-    EnableBackfaceCulling = false;
+    EnableLod = true;
+    EnableFrustumCulling = true;
+    EnableOcclusionCulling = true;
+    NbrObjectsCulled = 0;
+    NbrObjectsOcclusionTested = 0;
+    NbrObjectsOccluded = 0;
+    NbrOccludersDrawn = 0;
+    NbrTrianglesRendered = 0;
+    NbrTrianglesCulled = 0;
+    NbrTrianglesClipped = 0;
+    NbrTrianglesCulledByFacing = 0;
+    NbrPixelsTested = 0;
+    NbrPixelsShaded = 0;
+    NbrTilesRejected = 0;
+    NbrBlocksRejected = 0;
+    NbrVerticesTransformed = 0;
+    NbrDraws = 0;
+    ClearTime = 0.0;
+    ClearResolveTime = 0.0;
+    PresentTime = 0.0;
+    ConvertTime = 0.0;
+    CullingTime = 0.0;
+    OcclusionTime = 0.0;
+    VertexTime = 0.0;
+    TransformTime = 0.0;
+    RasterizationTime = 0.0;
+
+    m_TileClearValues.color = m_ClearColor;
+    m_TileClearValues.color16F = PackRgba16F(m_ClearColor);
+    m_TileClearValues.color8 = PackRgba8(m_ClearColor);
+
+    m_VertexBatches.resize(1);
 }
 
 Renderer::~Renderer()
 {
     DestroyFramebuffer();
-    delete[] m_ColorBuffer;
+
+    // The present thread could still be reading a color target
+    delete m_Presenter;
+    for (ColorTarget& target : m_ColorTargets)
+    {
+        delete[] target.color;
+        delete[] target.color16F;
+        delete[] target.color8;
+    }
     delete[] m_DepthBuffer;
+    delete[] m_DepthBuffer24;
+    delete[] m_DepthBuffer16;
+    delete[] m_VisibilityBuffer;
 }
 
 void Renderer::SetProjectionMatrix(const Matrix4x4& projection)
@@ -123,7 +365,8 @@ bool Renderer::SetPixel(const uint32_t x, const uint32_t y)
     if (y < 0 || y >= m_Height)
         return false;
 
-    m_ColorBuffer[ARR_2D_IDX(x, y)] = Vector4(1);
+    ClearPixelTile(x, y);
+    StoreColor(GetPixelOffset(x, y), Vector4(1));
     return true;
 }
 
@@ -135,30 +378,265 @@ bool Renderer::SetPixel(const uint32_t x, const uint32_t y, const Vector4& color
     if (y < 0 || y >= m_Height)
         return false;*/
 
-    m_ColorBuffer[ARR_2D_IDX(x, y)] = color;
+    ClearPixelTile(x, y);
+    StoreColor(GetPixelOffset(x, y), color);
     return true;
 }
 
 Vector4 Renderer::GetPixel(const uint32_t x, const uint32_t y)
 {
-    return m_ColorBuffer[ARR_2D_IDX(x, y)];
+    ClearPixelTile(x, y);
+    return LoadColor(GetPixelOffset(x, y));
+}
+
+void Renderer::WriteColor(const uint32_t offset, const float r, const float g, const float b, const float a)
+{
+    StoreColor(offset, Vector4(r, g, b, a));
 }
 
 void Renderer::ClearBuffers()
 {
-    for (uint32_t y = 0; y < m_Height; y++)
+    using std::chrono::high_resolution_clock;
+
+    const high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    // Objects are culled against the camera before their first draw
+    Camera.Update();
+
+    NbrObjectsCulled = 0;
+    NbrObjectsOcclusionTested = 0;
+    NbrObjectsOccluded = 0;
+    NbrOccludersDrawn = 0;
+    NbrTrianglesRendered = 0;
+    NbrTrianglesCulled = 0;
+    NbrTrianglesClipped = 0;
+    NbrTrianglesCulledByFacing = 0;
+    NbrPixelsTested = 0;
+    NbrPixelsShaded = 0;
+    NbrTilesRejected = 0;
+    NbrBlocksRejected = 0;
+    NbrVerticesTransformed = 0;
+    NbrDraws = 0;
+    ClearResolveTime = 0.0;
+    CullingTime = 0.0;
+    OcclusionTime = 0.0;
+    VertexTime = 0.0;
+    TransformTime = 0.0;
+    RasterizationTime = 0.0;
+
+    std::fill(m_BlockMaxDepths.begin(), m_BlockMaxDepths.end(), INFINITY);
+    m_OcclusionBuffer.Clear();
+
+    // Whatever wasn't resolved belongs to the previous frame, a resolve leaves the visibility buffer empty otherwise
+    if (!m_DeferredTriangles.empty())
+        std::fill(m_VisibilityBuffer, m_VisibilityBuffer + m_NbrStoredPixels, VISIBILITY_NONE);
+    m_DeferredDraws.clear();
+    m_DeferredTriangles.clear();
+
+    // The clear values are converted once, the pixels are only filled when their tile is first used
+    m_TileClearValues.color = m_ClearColor;
+    m_TileClearValues.color16F = PackRgba16F(m_ClearColor);
+    m_TileClearValues.color8 = PackRgba8(m_ClearColor);
+
+    for (Tile& tile : m_Tiles)
     {
-        for (uint32_t x = 0; x < m_Width; x++)
+        tile.maxDepth = INFINITY;
+        tile.maxDepthDirty = false;
+        tile.pendingColorClear = true;
+        tile.pendingDepthClear = true;
+    }
+
+    ClearTime = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+void Renderer::ClearTile(Tile& tile, const bool depth)
+{
+    const bool color = tile.pendingColorClear;
+    const bool depthStencil = depth && tile.pendingDepthClear;
+    tile.pendingColorClear = false;
+    tile.pendingDepthClear = tile.pendingDepthClear && !depth;
+
+    // Spans of consecutive pixels : the rows of the tile, or its rows of micro-tiles with the tiled layout
+    const bool tiled = m_Layout == FramebufferLayout::TILED;
+    const uint32_t nbrSpans = tiled ? tile.maxY / BLOCK_SIZE - tile.minY / BLOCK_SIZE + 1 : tile.maxY - tile.minY + 1;
+    const uint32_t spanSize = tiled ? (tile.maxX / BLOCK_SIZE - tile.minX / BLOCK_SIZE + 1) * BLOCK_SIZE * BLOCK_SIZE :
+        tile.maxX - tile.minX + 1;
+
+    for (uint32_t i = 0; i < nbrSpans; i++)
+    {
+        const uint32_t offset = GetPixelOffset(tile.minX, tile.minY + i * (tiled ? BLOCK_SIZE : 1));
+
+        if (color)
         {
-            uint32_t offset = ARR_2D_IDX(x, y);
+            switch (m_ColorFormat)
+            {
+                case ColorFormat::RGBA16F:
+                    std::fill_n(m_ColorBuffer16F + offset, spanSize, m_TileClearValues.color16F);
+                    break;
 
-            m_ColorBuffer[offset] = m_ClearColor;
-            m_DepthBuffer[offset] = INFINITY;
-            m_Stencil.StencilBuffer[offset] = 0.f;
+                case ColorFormat::RGBA8:
+                    std::fill_n(m_ColorBuffer8 + offset, spanSize, m_TileClearValues.color8);
+                    break;
+
+                default:
+                    std::fill_n(m_ColorBuffer + offset, spanSize, m_TileClearValues.color);
+            }
+        }
+
+        if (depthStencil)
+        {
+            switch (m_DepthFormat)
+            {
+                case DepthFormat::D24S8:
+                    // Clears the stencil in the low byte too
+                    std::fill_n(m_DepthBuffer24 + offset, spanSize, ((1u << DEPTH24_BITS) - 1) << 8);
+                    break;
+
+                case DepthFormat::D16:
+                    std::fill_n(m_DepthBuffer16 + offset, spanSize, static_cast<uint16_t>((1u << DEPTH16_BITS) - 1));
+                    m_Stencil.Clear(offset, spanSize);
+                    break;
+
+                default:
+                    std::fill_n(m_DepthBuffer + offset, spanSize, INFINITY);
+                    m_Stencil.Clear(offset, spanSize);
+            }
         }
     }
 }
 
+void Renderer::ClearPixelTile(const uint32_t x, const uint32_t y)
+{
+    Tile& tile = m_Tiles[y / TILE_SIZE * m_NbrTilesX + x / TILE_SIZE];
+    if (tile.pendingColorClear)
+        ClearTile(tile, false);
+}
+
+void Renderer::ResolveClears()
+{
+    using std::chrono::high_resolution_clock;
+
+    const high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    m_ActiveTiles.clear();
+    for (uint32_t i = 0; i < m_Tiles.size(); i++)
+    {
+        if (m_Tiles[i].pendingColorClear)
+            m_ActiveTiles.push_back(i);
+    }
+
+    // Only the colors are read, the depths of the tiles stay pending until something is drawn on them
+    if (!m_ActiveTiles.empty())
+    {
+        m_ThreadPool.ParallelFor(m_ActiveTiles.size(),
+            [this](const uint32_t i)
+            {
+                ClearTile(m_Tiles[m_ActiveTiles[i]], false);
+            });
+    }
+
+    ClearResolveTime += std::chrono::duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+void Renderer::PresentFrame()
+{
+    using std::chrono::high_resolution_clock;
+
+    const high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    ResolveClears();
+
+    if (m_Presenter != nullptr)
+    {
+        m_Presenter->Present(m_ColorTarget);
+
+        // The next frame is drawn in the next target, once the present thread is done with its previous frame
+        const uint32_t next = (m_ColorTarget + 1) % m_ColorTargets.size();
+        m_Presenter->WaitForTarget(next);
+        SelectColorTarget(next);
+
+        ConvertTime = m_Presenter->GetConvertTime();
+    }
+
+    PresentTime = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+const uint8_t* Renderer::GetPresentedFrame()
+{
+    if (m_Presenter == nullptr)
+        return nullptr;
+
+    m_Presenter->WaitForIdle();
+    ConvertTime = m_Presenter->GetConvertTime();
+
+    return m_Presenter->GetLatestFrame();
+}
+
+uint32_t Renderer::GetNbrColorTargets() const
+{
+    return m_ColorTargets.size();
+}
+
+bool Renderer::IsVisible(const Bounds& bounds, const Matrix4x4& model) const
+{
+    if (!EnableFrustumCulling)
+        return true;
+
+    const Frustum& frustum = Camera.GetFrustum();
+
+    // The sphere is scaled by the largest scaling of the model matrix, the length of its longest column
+    float scaleSquared = 0.f;
+    for (int c = 0; c < 3; c++)
+        scaleSquared = std::max(scaleSquared, model[0][c] * model[0][c] + model[1][c] * model[1][c] + model[2][c] * model[2][c]);
+
+    Matrix4x4 transform = model;
+    const Vector4 center = transform.Multiply(Vector4(bounds.Center.x, bounds.Center.y, bounds.Center.z, 1.f));
+
+    bool inside;
+    if (!frustum.IntersectsSphere(Vector3(center.x, center.y, center.z), bounds.Radius * std::sqrt(scaleSquared), inside))
+        return false;
+
+    if (inside)
+        return true;
+
+    // Only the spheres crossing a plane test the box, which is tighter for long objects : the world space box
+    // around the transformed one has the extents projected on each axis
+    const Vector3 boxCenter = (bounds.Min + bounds.Max) * .5f;
+    const Vector3 boxExtents = (bounds.Max - bounds.Min) * .5f;
+
+    const Vector4 worldCenter = transform.Multiply(Vector4(boxCenter.x, boxCenter.y, boxCenter.z, 1.f));
+    Vector3 worldExtents;
+    for (int r = 0; r < 3; r++)
+    {
+        worldExtents[r] = std::abs(model[r][0]) * boxExtents.x + std::abs(model[r][1]) * boxExtents.y +
+            std::abs(model[r][2]) * boxExtents.z;
+    }
+
+    return frustum.IntersectsBox(Vector3(worldCenter.x, worldCenter.y, worldCenter.z), worldExtents);
+}
+
+void Renderer::DrawOccluder(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+    const Matrix4x4& model)
+{
+    Matrix4x4 mvp = m_Projection;
+    mvp.Multiply(m_View).Multiply(model);
+
+    m_OcclusionBuffer.DrawOccluder(vertices, indices, mvp);
+    NbrOccludersDrawn++;
+}
+
+bool Renderer::IsOccluded(const Bounds& bounds, const Matrix4x4& model) const
+{
+    if (!EnableOcclusionCulling)
+        return false;
+
+    Matrix4x4 mvp = m_Projection;
+    mvp.Multiply(m_View).Multiply(model);
+
+    return m_OcclusionBuffer.IsOccluded(bounds, mvp);
+}
+
+#ifndef RENDERER_HEADLESS
 void Renderer::ForwardToImgui()
 {
     ImGuiIO& io = ImGui::GetIO();
@@ -172,134 +650,484 @@ void Renderer::ForwardToImgui()
 
         const ImVec2 size = ImVec2(m_FramebufferScale * m_Width, m_FramebufferScale * m_Height);
         ImGui::Image((ImTextureID)m_TextureId, size);
+
+        if (ImGui::IsItemClicked())
+        {
+            const ImVec2 mouse = ImGui::GetMousePos();
+            const ImVec2 corner = ImGui::GetItemRectMin();
+
+            m_ViewportClick = Vector2((mouse.x - corner.x) / m_FramebufferScale, (mouse.y - corner.y) / m_FramebufferScale);
+            m_HasViewportClick = true;
+        }
     }
     ImGui::End();
 }
 
-void Renderer::DrawTriangle(const Vector4& p1, const Vector4& p2, const Vector4& p3,
-    const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector3& normal)
+bool Renderer::GetViewportClick(Vector2& pixel)
+{
+    if (!m_HasViewportClick)
+        return false;
+
+    pixel = m_ViewportClick;
+    m_HasViewportClick = false;
+    return true;
+}
+#endif
+
+uint32_t Renderer::ComputeOutcode(const Vector4& position) const
+{
+    const float w = position.w;
+    const float guard = GUARD_BAND * w;
+
+    uint32_t code = 0;
+    code |= position.x < -w ? CLIP_LEFT : 0;
+    code |= position.x > w ? CLIP_RIGHT : 0;
+    code |= position.y < -w ? CLIP_BOTTOM : 0;
+    code |= position.y > w ? CLIP_TOP : 0;
+    code |= position.z < -w ? CLIP_NEAR : 0;
+    code |= position.z > w ? CLIP_FAR : 0;
+    code |= position.x < -guard ? CLIP_GUARD_LEFT : 0;
+    code |= position.x > guard ? CLIP_GUARD_RIGHT : 0;
+    code |= position.y < -guard ? CLIP_GUARD_BOTTOM : 0;
+    code |= position.y > guard ? CLIP_GUARD_TOP : 0;
+
+    return code;
+}
+
+// Signed distance of a vertex in clip space to one of the clipping planes, positive inside
+static float GetPlaneDistance(const uint32_t plane, const Vector4& position)
 {
-    if (EnableBackfaceCulling)
+    switch (plane)
     {
-        const Vector3 p = (Vector3(p1.x, p1.y, p1.z) - m_CameraScreenPosition).NormalizeSafe();
-        if (Vector3::DotProduct(p, normal) >= 0)
+    case CLIP_NEAR:
+        return position.z + position.w;
+    case CLIP_FAR:
+        return position.w - position.z;
+    case CLIP_GUARD_LEFT:
+        return position.x + GUARD_BAND * position.w;
+    case CLIP_GUARD_RIGHT:
+        return GUARD_BAND * position.w - position.x;
+    case CLIP_GUARD_BOTTOM:
+        return position.y + GUARD_BAND * position.w;
+    case CLIP_GUARD_TOP:
+        return GUARD_BAND * position.w - position.y;
+    default:
+        return 0.f;
+    }
+}
+
+void Renderer::ClipTriangle(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t indices[3],
+    const uint32_t face, const uint32_t planes)
+{
+    // Sutherland-Hodgman : the polygon is clipped by each plane in turn, which adds at most 1 vertex to it
+    uint32_t polygons[2][3 + CLIP_PLANE_COUNT];
+    uint32_t* input = polygons[0];
+    uint32_t* output = polygons[1];
+    uint32_t count = 3;
+
+    input[0] = indices[0];
+    input[1] = indices[1];
+    input[2] = indices[2];
+
+    for (uint32_t i = 0; i < CLIP_PLANE_COUNT; i++)
+    {
+        const uint32_t plane = 1 << i;
+        if ((planes & plane) == 0)
+            continue;
+
+        uint32_t outputCount = 0;
+        for (uint32_t j = 0; j < count; j++)
+        {
+            const uint32_t current = input[j];
+            const uint32_t next = input[(j + 1) % count];
+
+            const float d1 = GetPlaneDistance(plane, batch.GetClipPosition(current));
+            const float d2 = GetPlaneDistance(plane, batch.GetClipPosition(next));
+
+            if (d1 >= 0.f)
+                output[outputCount++] = current;
+
+            // Always interpolate from the inside vertex, so that the edge shared by 2 triangles is cut at the same place
+            if (d1 >= 0.f && d2 < 0.f)
+                output[outputCount++] = AddClippedVertex(batch, vertices, current, next, d1 / (d1 - d2));
+            else if (d1 < 0.f && d2 >= 0.f)
+                output[outputCount++] = AddClippedVertex(batch, vertices, next, current, d2 / (d2 - d1));
+        }
+
+        std::swap(input, output);
+        count = outputCount;
+
+        if (count < 3)
             return;
     }
 
-    NbrTrianglesRendered++;
+    // The clipped polygon is convex, split it as a fan
+    for (uint32_t i = 1; i + 1 < count; i++)
+        batch.assembledTriangles.push_back({ { input[0], input[i], input[i + 1] }, face });
+}
 
-    // Get color of each vertex
-    const Vector4& c1 = v1.m_Color;
-    const Vector4& c2 = v2.m_Color;
-    const Vector4& c3 = v3.m_Color;
+// Twice the signed area of a triangle in the 28.4 fixed point coordinates of the triangle setup
+static int64_t GetSnappedArea(const Vector4& p1, const Vector4& p2, const Vector4& p3)
+{
+    const int64_t x1 = std::lround(p1.x * SUBPIXEL_ONE), y1 = std::lround(p1.y * SUBPIXEL_ONE);
+    const int64_t x2 = std::lround(p2.x * SUBPIXEL_ONE), y2 = std::lround(p2.y * SUBPIXEL_ONE);
+    const int64_t x3 = std::lround(p3.x * SUBPIXEL_ONE), y3 = std::lround(p3.y * SUBPIXEL_ONE);
+    return (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
+}
 
-    // Get 2D coords of each vertex
-    const Vector2 points[3] = {
-        Vector2(p1.x, p1.y),
-        Vector2(p2.x, p2.y),
-        Vector2(p3.x, p3.y)
-    };
+bool Renderer::IsCulledByFacing(const float area) const
+{
+    if (m_CullMode == CullMode::NONE)
+        return false;
 
-    // Get the bounding box of the triangle (min/max of both X and Y)
-    // and clamp that bounding box to viewport, which discards the pixels outside of the viewport
-    // effectively clipping the triangle
-    float minX = std::min(p1.x, std::min(p2.x, p3.x));
-    minX = std::clamp<float>(minX, m_Viewport.x, m_Viewport.x + m_Viewport.width);
+    // The screen has y going up, as in normalized device coordinates, counter-clockwise triangles have a positive area
+    const bool front = m_FrontFace == FrontFace::CCW ? area > 0.f : area < 0.f;
+    return m_CullMode == CullMode::BACK ? !front : front;
+}
 
-    float maxX = std::max(p1.x, std::max(p2.x, p3.x));
-    maxX = std::clamp<float>(maxX, m_Viewport.x, m_Viewport.x + m_Viewport.width);
+uint32_t Renderer::AddClippedVertex(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t inside,
+    const uint32_t outside, const float t)
+{
+    const uint32_t nbrVertices = batch.nbrVertices;
+
+    // Copies, as adding the new vertex can reallocate the storage of the clipped ones
+    const Vertex a = inside < nbrVertices ? vertices[inside] : batch.clippedVertices[inside - nbrVertices];
+    const Vertex b = outside < nbrVertices ? vertices[outside] : batch.clippedVertices[outside - nbrVertices];
+    const Vector4 positionA = batch.GetClipPosition(inside);
+    const Vector4 positionB = batch.GetClipPosition(outside);
+
+    // Attributes are linear in clip space, before the perspective divide
+    batch.clippedClipPositions.push_back(positionA + (positionB - positionA) * t);
+    batch.clippedVertices.push_back(Vertex(
+        a.m_Position + (b.m_Position - a.m_Position) * t,
+        a.m_Color + (b.m_Color - a.m_Color) * t,
+        a.m_Normal + (b.m_Normal - a.m_Normal) * t,
+        a.m_Uvs + (b.m_Uvs - a.m_Uvs) * t
+    ));
+
+    return nbrVertices + static_cast<uint32_t>(batch.clippedClipPositions.size() - 1);
+}
+
+bool Renderer::SetupTriangle(const Vector4& p1, const Vector4& p2, const Vector4& p3,
+    const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vector3& normal, TriangleSetup& setup)
+{
+    // Convert the screen coordinates to 28.4 fixed point, so that the edge functions are exact
+    // and shared edges always produce the same values in both triangles
+    const Vector4* const positions[3] = { &p1, &p2, &p3 };
+    const Vertex* const vertices[3] = { &v1, &v2, &v3 };
+
+    int32_t fx[3];
+    int32_t fy[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const Vector4& pos = *positions[i];
 
-    float minY = std::min(p1.y, std::min(p2.y, p3.y));
-    minY = std::clamp<float>(minY, m_Viewport.y, m_Viewport.y + m_Viewport.height);
+        // Clipping against the guard band keeps the coordinates in the fixed point range, only invalid ones end up here
+        if (!(std::fabs(pos.x) < MAX_FIXED_COORD) || !(std::fabs(pos.y) < MAX_FIXED_COORD))
+            return false;
 
-    float maxY = std::max(p1.y, std::max(p2.y, p3.y));
-    maxY = std::clamp<float>(maxY, m_Viewport.y, m_Viewport.y + m_Viewport.height);
+        fx[i] = static_cast<int32_t>(std::lround(pos.x * SUBPIXEL_ONE));
+        fy[i] = static_cast<int32_t>(std::lround(pos.y * SUBPIXEL_ONE));
+    }
+
+    // Twice the signed area of the triangle, degenerate triangles cover no pixel
+    int64_t area = static_cast<int64_t>(fx[1] - fx[0]) * (fy[2] - fy[0]) -
+        static_cast<int64_t>(fy[1] - fy[0]) * (fx[2] - fx[0]);
+    if (area == 0)
+        return false;
 
-    for (uint32_t y = minY; y < maxY; y++)
+    // Both windings are rendered, so make the area positive by swapping the last 2 vertices
+    uint32_t order[3] = { 0, 1, 2 };
+    if (area < 0)
     {
-        for (uint32_t x = minX; x < maxX; x++)
-        {
-            // Convert the pixel to a Vector 3
-            Vector3 p = Vector3(x, y, 0.0f);
+        std::swap(order[1], order[2]);
+        std::swap(fx[1], fx[2]);
+        std::swap(fy[1], fy[2]);
+        area = -area;
+    }
 
-            // Compute the barycentric coordinates of the point
+    // Get the bounding box of the triangle (min/max of both X and Y), in pixels whose center can be covered
+    // and clamp that bounding box to viewport, which discards the pixels outside of the viewport
+    const int32_t viewportMaxX = std::min<int32_t>(m_Viewport.x + m_Viewport.width, m_Width) - 1;
+    const int32_t viewportMaxY = std::min<int32_t>(m_Viewport.y + m_Viewport.height, m_Height) - 1;
+
+    setup.minX = std::max<int32_t>((std::min(fx[0], std::min(fx[1], fx[2])) + SUBPIXEL_HALF - 1) >> SUBPIXEL_BITS,
+        std::max<int32_t>(m_Viewport.x, 0));
+    setup.maxX = std::min<int32_t>((std::max(fx[0], std::max(fx[1], fx[2])) - SUBPIXEL_HALF) >> SUBPIXEL_BITS,
+        viewportMaxX);
+    setup.minY = std::max<int32_t>((std::min(fy[0], std::min(fy[1], fy[2])) + SUBPIXEL_HALF - 1) >> SUBPIXEL_BITS,
+        std::max<int32_t>(m_Viewport.y, 0));
+    setup.maxY = std::min<int32_t>((std::max(fy[0], std::max(fy[1], fy[2])) - SUBPIXEL_HALF) >> SUBPIXEL_BITS,
+        viewportMaxY);
+
+    if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+        return false;
 
-            // Compute the denominator for the weight 1 and weight 2
-            const float denWeight = (points[1].y - points[2].y) * (points[0].x - points[2].x) +
-                (points[2].x - points[1].x) * (points[0].y - points[2].y);
+    // Setup the 3 edge functions, edge i is opposite to vertex i so its value is the barycentric weight of vertex i
+    // E(x, y) = (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x), evaluated at the center of the first pixel
+    const int32_t startX = (setup.minX << SUBPIXEL_BITS) + SUBPIXEL_HALF;
+    const int32_t startY = (setup.minY << SUBPIXEL_BITS) + SUBPIXEL_HALF;
 
-            // Compute each weight
-            // If any weight is negative, then that means the pixel is outside the triangle, thus abort
+    int64_t bias[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const uint32_t a = (i + 1) % 3;
+        const uint32_t b = (i + 2) % 3;
 
-            const float w1 = ((points[1].y - points[2].y) * (p.x - points[2].x) +
-                (points[2].x - points[1].x) * (p.y - points[2].y)) / denWeight;
-            if (w1 < 0)
-                continue;
+        const int32_t dx = fx[b] - fx[a];
+        const int32_t dy = fy[b] - fy[a];
 
-            const float w2 = ((points[2].y - points[0].y) * (p.x - points[2].x) +
-                (points[0].x - points[2].x) * (p.y - points[2].y)) / denWeight;
-            if (w2 < 0)
-                continue;
+        // Top-left fill rule : pixels exactly on an edge are only owned by the triangle for which
+        // the edge is a top or left edge, so shared edges are never drawn twice nor skipped
+        const bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+        bias[i] = topLeft ? 0 : 1;
 
-            const float w3 = 1 - w1 - w2;
-            if (w3 < 0)
-                continue;
+        setup.edge[i] = static_cast<int64_t>(dx) * (startY - fy[a]) - static_cast<int64_t>(dy) * (startX - fx[a]) -
+            bias[i];
+        setup.stepX[i] = -static_cast<int64_t>(dy) * SUBPIXEL_ONE;
+        setup.stepY[i] = static_cast<int64_t>(dx) * SUBPIXEL_ONE;
+    }
 
-            const float persp = p1.w * w1 + p2.w * w2 + p3.w * w3;
-            const Vector3 perspective = Vector3(w1, w2, w3) * Vector3(p1.w, p2.w, p3.w) * (1.f / persp);
+    setup.minDepth = std::min(p1.z, std::min(p2.z, p3.z)) - HIZ_EPSILON;
+    setup.maxDepth = std::max(p1.z, std::max(p2.z, p3.z)) + HIZ_EPSILON;
 
-            // Compute the depth of the current pixel
-            const float depth = p1.z * w1 + p2.z * w2 + p3.z * w3;
-            p.z = depth;
+    // The barycentric weight of vertex i is its (unbiased) edge function divided by the area, so it's known
+    // at the first pixel along with its change for 1 pixel, and so is any value that is linear in screen space
+    double weight[3];
+    double weightStepX[3];
+    double weightStepY[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        weight[i] = static_cast<double>(setup.edge[i] + bias[i]) / area;
+        weightStepX[i] = static_cast<double>(setup.stepX[i]) / area;
+        weightStepY[i] = static_cast<double>(setup.stepY[i]) / area;
+    }
 
-            if (depth < m_DepthBuffer[ARR_2D_IDX(x, y)])
-            {
-                m_DepthBuffer[ARR_2D_IDX(x, y)] = depth;
-            }
-            else
+    // Depth and 1/w are linear in screen space, the varyings become so once divided by w
+    float values[3][MAX_PLANES];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const Vector4& pos = *positions[order[i]];
+        const Vertex& vertex = *vertices[order[i]];
+        float* const varyings = values[i] + PLANE_VARYINGS;
+
+        values[i][PLANE_DEPTH] = pos.z;
+        values[i][PLANE_INV_W] = pos.w;
+
+        varyings[VARYING_COLOR + 0] = vertex.m_Color.x * pos.w;
+        varyings[VARYING_COLOR + 1] = vertex.m_Color.y * pos.w;
+        varyings[VARYING_COLOR + 2] = vertex.m_Color.z * pos.w;
+        varyings[VARYING_COLOR + 3] = vertex.m_Color.w * pos.w;
+        varyings[VARYING_UV + 0] = vertex.m_Uvs.x * pos.w;
+        varyings[VARYING_UV + 1] = vertex.m_Uvs.y * pos.w;
+    }
+
+    // Only the slots filled above are read, the planes past them are never interpolated
+    for (uint32_t i = 0; i < PLANE_VARYINGS + NBR_VERTEX_VARYINGS; i++)
+    {
+        setup.planeBase[i] = weight[0] * values[0][i] + weight[1] * values[1][i] + weight[2] * values[2][i];
+        setup.planeStepX[i] = weightStepX[0] * values[0][i] + weightStepX[1] * values[1][i] + weightStepX[2] * values[2][i];
+        setup.planeStepY[i] = weightStepY[0] * values[0][i] + weightStepY[1] * values[1][i] + weightStepY[2] * values[2][i];
+    }
+
+    setup.normal = normal;
+
+    return true;
+}
+
+void Renderer::DrawTriangle(const TriangleSetup& setup, Tile& tile)
+{
+    // Only walk the part of the bounding box that is inside of the tile
+    const int32_t minX = std::max(setup.minX, tile.minX);
+    const int32_t maxX = std::min(setup.maxX, tile.maxX);
+    const int32_t minY = std::max(setup.minY, tile.minY);
+    const int32_t maxY = std::min(setup.maxY, tile.maxY);
+
+    // Walk the bounding box in blocks aligned on the block grid, and classify each block using the value
+    // of the edge functions at its corners : since they're linear, their extremes are reached on the corners
+    for (int32_t blockY = minY & ~(BLOCK_SIZE - 1); blockY <= maxY; blockY += BLOCK_SIZE)
+    {
+        const int32_t y0 = std::max(blockY, minY);
+        const int32_t y1 = std::min(blockY + BLOCK_SIZE - 1, maxY);
+
+        for (int32_t blockX = minX & ~(BLOCK_SIZE - 1); blockX <= maxX; blockX += BLOCK_SIZE)
+        {
+            const int32_t x0 = std::max(blockX, minX);
+            const int32_t x1 = std::min(blockX + BLOCK_SIZE - 1, maxX);
+
+            int64_t edge[3];
+            bool outside = false;
+            bool inside = true;
+            for (uint32_t i = 0; i < 3; i++)
             {
-                continue;
+                edge[i] = setup.edge[i] + setup.stepX[i] * (x0 - setup.minX) + setup.stepY[i] * (y0 - setup.minY);
+
+                const int64_t acrossX = setup.stepX[i] * (x1 - x0);
+                const int64_t acrossY = setup.stepY[i] * (y1 - y0);
+
+                const int64_t lowest = edge[i] + std::min<int64_t>(acrossX, 0) + std::min<int64_t>(acrossY, 0);
+                const int64_t highest = edge[i] + std::max<int64_t>(acrossX, 0) + std::max<int64_t>(acrossY, 0);
+
+                outside |= highest < 0;
+                inside &= lowest >= 0;
             }
 
-            // Interpolate the color based on the weight of each point of the triangle and its color
-            // Since the sum of the weight is equal to 1, we can simply add and multiply
-            Vector4 color = c1 * perspective.x + c2 * perspective.y + c3 * perspective.z;
+            // Every corner is outside of the same edge, so is the whole block
+            if (outside)
+                continue;
 
-            if (m_Stencil.ApplyOperation(x, y))
+            // The depth test is strict, so the triangle is hidden in the block if it isn't closer than its farthest pixel
+            float& blockMaxDepth = m_BlockMaxDepths[(blockY / BLOCK_SIZE) * m_NbrBlocksX + blockX / BLOCK_SIZE];
+            if (setup.minDepth >= blockMaxDepth && m_SkipHiddenFragments)
             {
-                // The stencil signaled that the fragment should be discarded
+                tile.nbrBlocksRejected++;
                 continue;
             }
 
-            if (m_CurrentTexture != -1)
+            // Every pixel of a block the triangle fully covers ends up at most as far as the triangle,
+            // unless the stencil discards some of them
+            if (inside && !m_Stencil.IsEnabled() && x0 == blockX && y0 == blockY &&
+                x1 == std::min<int32_t>(blockX + BLOCK_SIZE, m_Width) - 1 &&
+                y1 == std::min<int32_t>(blockY + BLOCK_SIZE, m_Height) - 1 &&
+                setup.maxDepth < blockMaxDepth)
             {
-                const Texture& tex = m_Textures[m_CurrentTexture];
+                blockMaxDepth = setup.maxDepth;
+                tile.maxDepthDirty = true;
+            }
 
-                // Get uv of each vertex and weight them out
-                const Vector2 uv1 = v1.m_Uvs;
-                const Vector2 uv2 = v2.m_Uvs;
-                const Vector2 uv3 = v3.m_Uvs;
-                const Vector2 uvs = uv1 * perspective.x + uv2 * perspective.y + uv3 * perspective.z;
+#ifdef RENDERER_SIMD_X86
+            // The vectorized paths work on whole aligned blocks, so they can't be used on the borders of the framebuffer.
+            // They test the depth before anything else, so the stencil has to be tested by the scalar path
+            if (m_FragmentPath != FragmentPath::SCALAR && !m_Stencil.IsEnabled() &&
+                blockX + BLOCK_SIZE <= static_cast<int32_t>(m_Width) && blockY + BLOCK_SIZE <= static_cast<int32_t>(m_Height))
+            {
+                const bool drawn = m_FragmentPath == FragmentPath::AVX2 ?
+                    DrawBlockSimd<Avx2Lanes>(setup, tile, blockX, blockY, x0, y0, x1, y1, edge, inside) :
+                    DrawBlockSimd<Sse4Lanes>(setup, tile, blockX, blockY, x0, y0, x1, y1, edge, inside);
 
-                // Sample the corresponding texel
-                // and multiply it with the color so that combining may be achieved
-                color *= tex.SampleTexel(uvs);
+                if (drawn)
+                    continue;
             }
+#endif
+
+            (this->*m_Pipeline.drawBlock[!inside])(setup, tile, x0, y0, x1, y1, edge);
+        }
+    }
+}
+
+bool Renderer::FinishFragment(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+    const float varyings[MAX_VARYINGS])
+{
+    // The tile was resolved before its blocks were drawn, so the pixel is accessed directly
+    const uint32_t offset = GetPixelOffset(x, y);
+
+    Vector4 color = ComputeFragmentColor(setup, x, y, depth, varyings, m_CurrentTexture, CurrentMaterial);
+    
+    if (m_Blending.Enabled)
+    {
+        color = m_Blending.ComputeBlending(LoadColor(offset), color);
+    }
+
+    // Apply the resulting color
+    StoreColor(offset, color);
+    return true;
+}
+
+Vector4 Renderer::ComputeFragmentColor(const TriangleSetup& setup, const int32_t x, const int32_t y, const float depth,
+    const float varyings[MAX_VARYINGS], const int32_t texture, const Material& material)
+{
+    Vector4 color = Vector4(
+        varyings[VARYING_COLOR + 0],
+        varyings[VARYING_COLOR + 1],
+        varyings[VARYING_COLOR + 2],
+        varyings[VARYING_COLOR + 3]
+    );
+
+    if (texture != -1)
+    {
+        const Texture& tex = m_Textures[texture];
+
+        // Sample the corresponding texel
+        // and multiply it with the color so that combining may be achieved
+        color *= tex.SampleTexel(Vector2(varyings[VARYING_UV + 0], varyings[VARYING_UV + 1]));
+    }
+
+    return ApplyLights(Vector3(x, y, depth), color, setup.normal, material);
+}
+
+void Renderer::ResolveVisibilityBuffer()
+{
+    if (m_DeferredTriangles.empty())
+        return;
+
+    using std::chrono::high_resolution_clock;
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    std::atomic<uint64_t> nbrPixelsShaded = 0;
+
+    // Lights are applied as they are when resolving, so the pipelines are picked now
+    UpdateActiveLights();
+
+    std::vector<ComputeColorFunc> computeColors = std::vector<ComputeColorFunc>(m_DeferredDraws.size());
+    for (size_t i = 0; i < m_DeferredDraws.size(); i++)
+    {
+        computeColors[i] = GetFragmentPipeline(m_DeferredDraws[i].texture, BlendMode::NONE, StencilMode::NONE).computeColor;
+    }
+
+    // Each pixel only depends on its own triangle, so rows are shaded independently
+    m_ThreadPool.ParallelFor(m_Height,
+        [this, &nbrPixelsShaded, &computeColors](const uint32_t y)
+        {
+            uint64_t nbrShaded = 0;
 
-            color = ApplyLights(p, color, normal);
-            
-            if (m_Blending.Enabled)
+            for (uint32_t x = 0; x < m_Width; x++)
             {
-                color = m_Blending.ComputeBlending(GetPixel(x, y), color);
+                const uint32_t offset = GetPixelOffset(x, y);
+
+                const uint32_t id = m_VisibilityBuffer[offset];
+                if (id == VISIBILITY_NONE)
+                    continue;
+
+                m_VisibilityBuffer[offset] = VISIBILITY_NONE;
+
+                const DeferredTriangle& triangle = m_DeferredTriangles[id];
+                const TriangleSetup& setup = triangle.setup;
+                const DeferredDraw& draw = m_DeferredDraws[triangle.draw];
+
+                // Evaluate the plane equations of the triangle at the pixel
+                const int32_t dx = static_cast<int32_t>(x) - setup.minX;
+                const int32_t dy = static_cast<int32_t>(y) - setup.minY;
+                const float w = 1.f / (setup.planeBase[PLANE_INV_W] +
+                    setup.planeStepX[PLANE_INV_W] * dx + setup.planeStepY[PLANE_INV_W] * dy);
+
+                float varyings[MAX_VARYINGS];
+                for (uint32_t i = 0; i < draw.nbrVaryings; i++)
+                {
+                    const uint32_t plane = PLANE_VARYINGS + i;
+                    varyings[i] = (setup.planeBase[plane] + setup.planeStepX[plane] * dx + setup.planeStepY[plane] * dy) * w;
+                }
+
+                StoreColor(offset, (this->*computeColors[triangle.draw])(setup, x, y, LoadDepth(offset),
+                    varyings, draw.texture, draw.material));
+                nbrShaded++;
             }
 
-            // Apply the resulting color
-            SetPixel(x, y, color);
+            nbrPixelsShaded += nbrShaded;
         }
-    }
+    );
+
+    NbrPixelsShaded += nbrPixelsShaded;
+
+    m_DeferredDraws.clear();
+    m_DeferredTriangles.clear();
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    RasterizationTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
 }
 
-Vector4 Renderer::ApplyLights(const Vector3& position, const Vector4& currColor, const Vector3& normal)
+Vector4 Renderer::ApplyLights(const Vector3& position, const Vector4& currColor, const Vector3& normal,
+    const Material& material)
 {
     // Start from the current color
     Vector4 newColor = currColor;
@@ -310,33 +1138,60 @@ Vector4 Renderer::ApplyLights(const Vector3& position, const Vector4& currColor,
         if (!light.Enabled)
             continue;
 
-        const Vector3 lightPos = light.Position;
-
-        // Direction between light and fragment
-        const Vector3 lightDir = Vector3(position, lightPos).Normalize();
-        
-        // Get diffuse and specular
-        const Vector4 ambient = light.Ambient * CurrentMaterial.Ambient;
-        const Vector4 diffuse = light.ComputeDiffuse(lightDir, position, normal, CurrentMaterial);
-        const Vector4 specular = light.ComputeSpecular(lightDir, position, m_CameraScreenPosition,
-            normal, CurrentMaterial);
-
-        // Get actual computed light
-        const Vector4 computedLight = (ambient + diffuse + specular);
-
         // Apply it to the color
-        newColor *= computedLight;
+        newColor *= ComputeLight(light, position, normal, material);
     }
 
     return newColor;
 }
 
+Vector4 Renderer::ComputeLight(const Light& light, const Vector3& position, const Vector3& normal,
+    const Material& material) const
+{
+    const Vector3 lightPos = light.Position;
+
+    // Direction between light and fragment
+    const Vector3 lightDir = Vector3(position, lightPos).Normalize();
+
+    // Get diffuse and specular
+    const Vector4 ambient = light.Ambient * material.Ambient;
+    const Vector4 diffuse = light.ComputeDiffuse(lightDir, position, normal, material);
+    const Vector4 specular = light.ComputeSpecular(lightDir, position, m_CameraScreenPosition,
+        normal, material);
+
+    // Get actual computed light
+    return ambient + diffuse + specular;
+}
+
 void Renderer::ProcessVertices(const std::vector<Vertex>& vertices)
 {
     assert(vertices.size() % 3 == 0 && "Number of vertices wasn't a multiple of 3");
 
+    // Vertices that aren't indexed are referenced in order, each by a single triangle
+    const size_t nbrIndices = m_SequentialIndices.size();
+    if (nbrIndices < vertices.size())
+    {
+        m_SequentialIndices.resize(vertices.size());
+        for (size_t i = nbrIndices; i < vertices.size(); i++)
+            m_SequentialIndices[i] = static_cast<uint32_t>(i);
+    }
+
+    DrawTriangles(vertices, m_SequentialIndices.data(), static_cast<uint32_t>(vertices.size()));
+}
+
+void Renderer::DrawIndexed(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    assert(indices.size() % 3 == 0 && "Number of indices wasn't a multiple of 3");
+
+    DrawTriangles(vertices, indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+void Renderer::BeginDraw()
+{
+#ifndef RENDERER_HEADLESS
     if (!m_StopTime)
         m_Time += ImGui::GetIO().DeltaTime;
+#endif
 
     for (size_t i = 0; i < MAX_AMOUNT_OF_LIGHTS; i++)
     {
@@ -345,50 +1200,528 @@ void Renderer::ProcessVertices(const std::vector<Vertex>& vertices)
         light.Render(*this);
     }
 
-    Camera.Update();
-   
+    // The camera was updated by ClearBuffers, the matrices set since then are kept
     const Vector4 camPos = NdcToScreenCoords(Camera.Position, true);
     m_CameraScreenPosition = Vector3(camPos.x, camPos.y, camPos.z);
 
-    std::vector<Vector4> transformed = std::vector<Vector4>(vertices.size());
-    std::vector<Vector3> normals = std::vector<Vector3>(vertices.size() / 3);
+    NbrDraws++;
+
+    // Blending and the stencil depend on the order fragments are drawn in, so those draws are rendered forward,
+    // over the opaque pixels deferred so far
+    m_DeferredDraw = m_RenderMode == RenderMode::DEFERRED && !m_Stencil.IsEnabled() && !m_Blending.Enabled;
+
+    // Varyings the vertices of the draw carry
+    m_NbrVaryings = NBR_VERTEX_VARYINGS;
+
+    if (m_DeferredDraw)
+        m_DeferredDraws.push_back({ m_CurrentTexture, m_NbrVaryings, CurrentMaterial });
+    else
+        ResolveVisibilityBuffer();
+
+    // Pick the fragment pipeline of the draw, instead of testing its state for every fragment
+    UpdateActiveLights();
+    m_Pipeline = GetFragmentPipeline(m_CurrentTexture, m_Blending.GetMode(), m_Stencil.GetMode());
+
+    // Gather the state the vectorized fragment paths need to shade the fragments themselves
+    m_FastFragments = !m_Stencil.IsEnabled() && !m_Blending.Enabled && m_ActiveLights.empty();
+    m_SkipHiddenFragments = m_Stencil.KeepsHiddenFragments();
+
+    m_TextureData = nullptr;
+    if (m_CurrentTexture != -1)
+    {
+        const Texture& texture = m_Textures[m_CurrentTexture];
+
+        m_TextureData = texture.GetData();
+        m_TextureWidth = texture.GetWidth();
+        m_TextureHeight = texture.GetHeight();
+    }
+}
+
+void Renderer::DrawTriangles(const std::vector<Vertex>& vertices, const uint32_t* const indices, const uint32_t nbrIndices)
+{
+    BeginDraw();
+
+    using std::chrono::high_resolution_clock;
+
+    const uint32_t nbrTriangles = nbrIndices / 3;
+    const uint32_t nbrBatches = std::min(m_ThreadPool.GetNbrThreads() * INSTANCE_BATCHES_PER_THREAD,
+        nbrTriangles / MIN_TRIANGLES_PER_BATCH);
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    if (nbrBatches > 1)
+        ProcessDraw(vertices, indices, nbrTriangles, nbrBatches);
+    else
+        ProcessInstance(m_VertexBatches[0], vertices, indices, nbrIndices, m_Model);
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    VertexTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+    for (uint32_t i = 0; i < std::max(nbrBatches, 1u); i++)
+        SubmitBatch(m_VertexBatches[i]);
+
+    RasterizeTiles();
+}
+
+void Renderer::ProcessDraw(const std::vector<Vertex>& vertices, const uint32_t* const indices, const uint32_t nbrTriangles,
+    const uint32_t nbrBatches)
+{
+    const uint32_t nbrVertices = static_cast<uint32_t>(vertices.size());
+
+    if (m_VertexBatches.size() < nbrBatches)
+        m_VertexBatches.resize(nbrBatches);
+
+    // The vertices are transformed by ranges, into the positions of the draw, so that the ones shared by the triangles
+    // of several batches are only transformed once. Every vertex is transformed, even those the indices don't reference
+    if (m_SequentialIndices.size() < nbrVertices)
+    {
+        const size_t nbrIndices = m_SequentialIndices.size();
+        m_SequentialIndices.resize(nbrVertices);
+        for (size_t i = nbrIndices; i < nbrVertices; i++)
+            m_SequentialIndices[i] = static_cast<uint32_t>(i);
+    }
+
+    m_DrawClipPositions.resize(nbrVertices);
+    m_DrawScreenPositions.resize(nbrVertices);
 
-    const Matrix3x3 rotation = Matrix3x3(
+    Matrix4x4 mvp = m_Projection;
+    mvp.Multiply(m_View).Multiply(m_Model);
+
+    m_ThreadPool.ParallelFor(nbrBatches,
+        [&](const uint32_t i)
+        {
+            using std::chrono::high_resolution_clock;
+
+            VertexBatch& batch = m_VertexBatches[i];
+
+            const uint32_t first = nbrVertices * i / nbrBatches;
+            const uint32_t last = nbrVertices * (i + 1) / nbrBatches;
+
+            high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+            TransformVertices(mvp, vertices, m_SequentialIndices.data() + first, last - first,
+                m_DrawClipPositions.data(), m_DrawScreenPositions.data());
+
+            high_resolution_clock::time_point t2 = high_resolution_clock::now();
+            batch.transformTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
+            batch.nbrVerticesTransformed += last - first;
+        }
+    );
+
+    // Then each batch assembles and sets up a range of consecutive triangles
+    const Matrix3x3 rotation(
         m_Model.Row0.x, m_Model.Row0.y, m_Model.Row0.z,
         m_Model.Row1.x, m_Model.Row1.y, m_Model.Row1.z,
         m_Model.Row2.x, m_Model.Row2.y, m_Model.Row2.z
     );
 
-    for (size_t i = 0; i < vertices.size(); i++)
+    m_ThreadPool.ParallelFor(nbrBatches,
+        [&](const uint32_t i)
+        {
+            VertexBatch& batch = m_VertexBatches[i];
+            batch.mvp = mvp;
+            batch.rotation = rotation;
+            batch.vertexClipPositions = m_DrawClipPositions.data();
+            batch.vertexScreenPositions = m_DrawScreenPositions.data();
+            batch.nbrVertices = nbrVertices;
+
+            const uint32_t first = nbrTriangles * i / nbrBatches;
+            const uint32_t last = nbrTriangles * (i + 1) / nbrBatches;
+            AssembleTriangles(batch, vertices, indices + first * 3, last - first);
+        }
+    );
+}
+
+void Renderer::DrawInstanced(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+    const std::span<const Matrix4x4> models)
+{
+    assert(indices.size() % 3 == 0 && "Number of indices wasn't a multiple of 3");
+
+    if (models.empty())
+        return;
+
+    BeginDraw();
+
+    using std::chrono::high_resolution_clock;
+
+    const uint32_t nbrInstances = static_cast<uint32_t>(models.size());
+    const uint32_t maxBatches = m_ThreadPool.GetNbrThreads() * INSTANCE_BATCHES_PER_THREAD;
+    if (m_VertexBatches.size() < maxBatches)
+        m_VertexBatches.resize(maxBatches);
+
+    for (uint32_t offset = 0; offset < nbrInstances; offset += MAX_INSTANCES_IN_FLIGHT)
+    {
+        const uint32_t nbrInFlight = std::min(nbrInstances - offset, static_cast<uint32_t>(MAX_INSTANCES_IN_FLIGHT));
+        const uint32_t nbrBatches = std::min(nbrInFlight, maxBatches);
+
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+        // Consecutive instances are processed by the same batch, so that the triangles come out of the batches
+        // in the order of the instances
+        m_ThreadPool.ParallelFor(nbrBatches,
+            [&](const uint32_t i)
+            {
+                VertexBatch& batch = m_VertexBatches[i];
+
+                const uint32_t first = offset + nbrInFlight * i / nbrBatches;
+                const uint32_t last = offset + nbrInFlight * (i + 1) / nbrBatches;
+                for (uint32_t instance = first; instance < last; instance++)
+                {
+                    ProcessInstance(batch, vertices, indices.data(), static_cast<uint32_t>(indices.size()),
+                        models[instance]);
+                }
+            }
+        );
+
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        VertexTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        for (uint32_t i = 0; i < nbrBatches; i++)
+            SubmitBatch(m_VertexBatches[i]);
+    }
+
+    // Every instance is rasterized at once, the tiles go through all of their triangles in a single pass
+    RasterizeTiles();
+}
+
+void Renderer::ProcessInstance(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t* const indices,
+    const uint32_t nbrIndices, const Matrix4x4& model)
+{
+    const uint32_t nbrVertices = static_cast<uint32_t>(vertices.size());
+    const uint32_t nbrTriangles = nbrIndices / 3;
+
+    // The matrices are multiplied once per instance rather than for each vertex
+    batch.mvp = m_Projection;
+    batch.mvp.Multiply(m_View).Multiply(model);
+
+    batch.rotation = Matrix3x3(
+        model.Row0.x, model.Row0.y, model.Row0.z,
+        model.Row1.x, model.Row1.y, model.Row1.z,
+        model.Row2.x, model.Row2.y, model.Row2.z
+    );
+
+    // Post-transform cache : vertices are listed the first time the instance references them, and their
+    // transform reused by the other triangles sharing them. A vertex is listed for the instance whose stamp it holds
+    if (batch.transformStamps.size() < nbrVertices)
+        batch.transformStamps.resize(nbrVertices, 0);
+
+    if (++batch.transformStamp == 0)
+    {
+        std::fill(batch.transformStamps.begin(), batch.transformStamps.end(), 0);
+        batch.transformStamp = 1;
+    }
+
+    batch.clipPositions.resize(nbrVertices);
+    batch.screenPositions.resize(nbrVertices);
+
+    // Vertices shared by several triangles are only listed once
+    batch.vertexList.clear();
+    for (uint32_t i = 0; i < nbrTriangles * 3; i++)
+    {
+        const uint32_t index = indices[i];
+        assert(index < nbrVertices && "Index out of the vertices of the draw");
+
+        if (batch.transformStamps[index] == batch.transformStamp)
+            continue;
+
+        batch.transformStamps[index] = batch.transformStamp;
+        batch.vertexList.push_back(index);
+    }
+
+    using std::chrono::high_resolution_clock;
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    TransformVertices(batch.mvp, vertices, batch.vertexList.data(), static_cast<uint32_t>(batch.vertexList.size()),
+        batch.clipPositions.data(), batch.screenPositions.data());
+    batch.nbrVerticesTransformed += static_cast<uint32_t>(batch.vertexList.size());
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    batch.transformTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+    batch.vertexClipPositions = batch.clipPositions.data();
+    batch.vertexScreenPositions = batch.screenPositions.data();
+    batch.nbrVertices = nbrVertices;
+    AssembleTriangles(batch, vertices, indices, nbrTriangles);
+}
+
+void Renderer::AssembleTriangles(VertexBatch& batch, const std::vector<Vertex>& vertices, const uint32_t* const indices,
+    const uint32_t nbrTriangles)
+{
+    const uint32_t nbrVertices = batch.nbrVertices;
+    batch.normals.resize(nbrTriangles);
+
+    // Primitive assembly : triangles outside of the frustum are culled, and so are the ones facing the way
+    // the cull mode discards. The ones crossing the near or far plane or going past the guard band are clipped,
+    // which can create new vertices
+    batch.clippedClipPositions.clear();
+    batch.clippedVertices.clear();
+    batch.assembledTriangles.clear();
+    for (uint32_t i = 0; i < nbrTriangles; i++)
     {
-        const Vertex& vertex = vertices[i];
+        const uint32_t* const triangle = &indices[i * 3];
+
+        const Vector4& clip1 = batch.vertexClipPositions[triangle[0]];
+        const Vector4& clip2 = batch.vertexClipPositions[triangle[1]];
+        const Vector4& clip3 = batch.vertexClipPositions[triangle[2]];
 
-        if ((i % 3) == 0)
+        const uint32_t code1 = ComputeOutcode(clip1);
+        const uint32_t code2 = ComputeOutcode(clip2);
+        const uint32_t code3 = ComputeOutcode(clip3);
+
+        if ((code1 & code2 & code3) != 0)
         {
-            normals[i / 3] = rotation.Multiply(vertex.m_Normal).NormalizeSafe();
+            batch.nbrTrianglesCulled++;
+            continue;
         }
 
-        transformed[i] = ApplyTransformationPipeline(vertex);
+        const uint32_t planes = (code1 | code2 | code3) & CLIP_PLANES;
+        if (planes != 0)
+        {
+            // Vertices behind the camera don't have a position on the screen, but the determinant of the homogeneous
+            // positions has the sign of the area the triangle is projected with, whatever the sign of their w
+            const float determinant = clip1.x * (clip2.y * clip3.w - clip3.y * clip2.w) -
+                clip1.y * (clip2.x * clip3.w - clip3.x * clip2.w) + clip1.w * (clip2.x * clip3.y - clip3.x * clip2.y);
+
+            // Degenerate triangles have no facing, they cover no pixel and are dropped like in the triangle setup
+            if (determinant == 0.f)
+                continue;
+
+            if (IsCulledByFacing(determinant))
+            {
+                batch.nbrTrianglesCulledByFacing++;
+                continue;
+            }
+
+            batch.nbrTrianglesClipped++;
+            batch.normals[i] = batch.rotation.Multiply(vertices[triangle[0]].m_Normal).NormalizeSafe();
+            ClipTriangle(batch, vertices, triangle, i, planes);
+            continue;
+        }
+
+        const Vector4& screen1 = batch.vertexScreenPositions[triangle[0]];
+        const Vector4& screen2 = batch.vertexScreenPositions[triangle[1]];
+        const Vector4& screen3 = batch.vertexScreenPositions[triangle[2]];
+
+        // Triangles snapping to a zero area cover no pixel, the triangle setup would drop them without a facing
+        const int64_t area = GetSnappedArea(screen1, screen2, screen3);
+        if (area == 0)
+            continue;
+
+        if (IsCulledByFacing(static_cast<float>(area)))
+        {
+            batch.nbrTrianglesCulledByFacing++;
+            continue;
+        }
+
+        batch.normals[i] = batch.rotation.Multiply(vertices[triangle[0]].m_Normal).NormalizeSafe();
+        batch.assembledTriangles.push_back({ { triangle[0], triangle[1], triangle[2] }, i });
     }
 
-    NbrTrianglesRendered = 0;
-    for (size_t i = 0; i < vertices.size() / 3; i++)
+    // The vertices created by clipping are inside of the frustum, they only need to be projected
+    batch.clippedScreenPositions.resize(batch.clippedClipPositions.size());
+    for (size_t i = 0; i < batch.clippedClipPositions.size(); i++)
+        batch.clippedScreenPositions[i] = ClipToScreenCoords(batch.clippedClipPositions[i]);
+
+    for (const AssembledTriangle& triangle : batch.assembledTriangles)
     {
-        const size_t tri = i * 3;
-        /*if (i == 1)
+        const Vertex* triangleVertices[3];
+        for (uint32_t j = 0; j < 3; j++)
         {
-            m_Textures[m_CurrentTexture].SetFiltering(TexFiltering::LINEAR);
+            const uint32_t index = triangle.indices[j];
+            triangleVertices[j] = index < nbrVertices ? &vertices[index] : &batch.clippedVertices[index - nbrVertices];
         }
-        else
+
+        TriangleSetup setup;
+        if (!SetupTriangle(batch.GetScreenPosition(triangle.indices[0]), batch.GetScreenPosition(triangle.indices[1]),
+            batch.GetScreenPosition(triangle.indices[2]), *triangleVertices[0], *triangleVertices[1], *triangleVertices[2],
+            batch.normals[triangle.face], setup))
+            continue;
+
+        batch.setups.push_back(setup);
+    }
+}
+
+void Renderer::SubmitBatch(VertexBatch& batch)
+{
+    for (TriangleSetup& setup : batch.setups)
+    {
+        if (m_DeferredDraw)
+        {
+            // Keep a copy of the setup for the resolve, the tiles are done with theirs once the draw is
+            setup.id = static_cast<uint32_t>(m_DeferredTriangles.size());
+            m_DeferredTriangles.push_back({ setup, static_cast<uint32_t>(m_DeferredDraws.size() - 1) });
+        }
+
+        m_TriangleSetups.push_back(setup);
+        BinTriangle(static_cast<uint32_t>(m_TriangleSetups.size() - 1));
+    }
+
+    NbrVerticesTransformed += batch.nbrVerticesTransformed;
+    NbrTrianglesRendered += static_cast<uint32_t>(batch.setups.size());
+    NbrTrianglesCulled += batch.nbrTrianglesCulled;
+    NbrTrianglesClipped += batch.nbrTrianglesClipped;
+    NbrTrianglesCulledByFacing += batch.nbrTrianglesCulledByFacing;
+    TransformTime += batch.transformTime;
+
+    batch.setups.clear();
+    batch.nbrVerticesTransformed = 0;
+    batch.nbrTrianglesCulled = 0;
+    batch.nbrTrianglesClipped = 0;
+    batch.nbrTrianglesCulledByFacing = 0;
+    batch.transformTime = 0.0;
+}
+
+void Renderer::TransformVertices(const Matrix4x4& mvp, const std::vector<Vertex>& vertices, const uint32_t* const list,
+    const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const
+{
+#ifdef RENDERER_SIMD_X86
+    if (m_FragmentPath == FragmentPath::AVX2)
+    {
+        TransformVerticesSimd<Avx2Lanes>(mvp, vertices.data(), list, count, clipPositions, screenPositions);
+        return;
+    }
+
+    if (m_FragmentPath == FragmentPath::SSE4)
+    {
+        TransformVerticesSimd<Sse4Lanes>(mvp, vertices.data(), list, count, clipPositions, screenPositions);
+        return;
+    }
+#endif
+
+    // The position stays in clip space until the triangle has been clipped
+    Matrix4x4 transform = mvp;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t index = list[i];
+
+        clipPositions[index] = transform.Multiply(Vector4(vertices[index].m_Position, 1.0f));
+        screenPositions[index] = ClipToScreenCoords(clipPositions[index]);
+    }
+}
+
+void Renderer::CreateTiles()
+{
+    m_NbrTilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+    m_NbrTilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_Tiles.resize(m_NbrTilesX * m_NbrTilesY);
+    for (uint32_t y = 0; y < m_NbrTilesY; y++)
+    {
+        for (uint32_t x = 0; x < m_NbrTilesX; x++)
         {
-            m_Textures[m_CurrentTexture].SetFiltering(TexFiltering::NEAREST);
-        }*/
+            Tile& tile = m_Tiles[y * m_NbrTilesX + x];
+
+            tile.minX = x * TILE_SIZE;
+            tile.minY = y * TILE_SIZE;
+            tile.maxX = std::min((x + 1) * TILE_SIZE, m_Width) - 1;
+            tile.maxY = std::min((y + 1) * TILE_SIZE, m_Height) - 1;
+
+            tile.maxDepth = INFINITY;
+            tile.maxDepthDirty = false;
+            tile.pendingColorClear = true;
+            tile.pendingDepthClear = true;
+
+            tile.nbrPixelsTested = 0;
+            tile.nbrPixelsShaded = 0;
+            tile.nbrTrianglesRejected = 0;
+            tile.nbrBlocksRejected = 0;
+        }
+    }
+}
+
+void Renderer::UpdateTileMaxDepth(Tile& tile)
+{
+    float maxDepth = 0.f;
+    for (int32_t y = tile.minY / BLOCK_SIZE; y <= tile.maxY / BLOCK_SIZE; y++)
+    {
+        for (int32_t x = tile.minX / BLOCK_SIZE; x <= tile.maxX / BLOCK_SIZE; x++)
+            maxDepth = std::max(maxDepth, m_BlockMaxDepths[y * m_NbrBlocksX + x]);
+    }
+
+    tile.maxDepth = maxDepth;
+    tile.maxDepthDirty = false;
+}
+
+void Renderer::BinTriangle(const uint32_t index)
+{
+    const TriangleSetup& setup = m_TriangleSetups[index];
+
+    // The bounds are signed, dividing them by the unsigned TILE_SIZE would wrap a negative one to a huge tile index
+    constexpr int32_t tileSize = static_cast<int32_t>(TILE_SIZE);
 
-        DrawTriangle(transformed[tri], transformed[tri + 1], transformed[tri + 2],
-            vertices[tri], vertices[tri + 1], vertices[tri + 2], normals[i]);
+    // Triangles are binned in submission order, so each tile draws them in the same order as a serial renderer would
+    for (int32_t y = setup.minY / tileSize; y <= setup.maxY / tileSize; y++)
+    {
+        for (int32_t x = setup.minX / tileSize; x <= setup.maxX / tileSize; x++)
+            m_Tiles[y * m_NbrTilesX + x].triangles.push_back(index);
     }
 }
 
+void Renderer::RasterizeTiles()
+{
+    using std::chrono::high_resolution_clock;
+
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    m_ActiveTiles.clear();
+    for (uint32_t i = 0; i < m_Tiles.size(); i++)
+    {
+        if (!m_Tiles[i].triangles.empty())
+            m_ActiveTiles.push_back(i);
+    }
+
+    // Tiles don't overlap, so each thread owns the color, depth and stencil pixels of the tile it works on
+    m_ThreadPool.ParallelFor(m_ActiveTiles.size(),
+        [this](const uint32_t i)
+        {
+            Tile& tile = m_Tiles[m_ActiveTiles[i]];
+
+            if (tile.pendingColorClear || tile.pendingDepthClear)
+                ClearTile(tile, true);
+
+            for (const uint32_t triangle : tile.triangles)
+            {
+                const TriangleSetup& setup = m_TriangleSetups[triangle];
+
+                if (tile.maxDepthDirty)
+                    UpdateTileMaxDepth(tile);
+
+                // Hidden behind everything already drawn in the tile
+                if (setup.minDepth >= tile.maxDepth && m_SkipHiddenFragments)
+                {
+                    tile.nbrTrianglesRejected++;
+                    continue;
+                }
+
+                DrawTriangle(setup, tile);
+            }
+
+            tile.triangles.clear();
+        }
+    );
+
+    m_TriangleSetups.clear();
+
+    for (const uint32_t i : m_ActiveTiles)
+    {
+        Tile& tile = m_Tiles[i];
+
+        NbrPixelsTested += tile.nbrPixelsTested;
+        NbrPixelsShaded += tile.nbrPixelsShaded;
+        NbrTilesRejected += tile.nbrTrianglesRejected;
+        NbrBlocksRejected += tile.nbrBlocksRejected;
+
+        tile.nbrPixelsTested = 0;
+        tile.nbrPixelsShaded = 0;
+        tile.nbrTrianglesRejected = 0;
+        tile.nbrBlocksRejected = 0;
+    }
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    RasterizationTime += std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
 void Renderer::BindTexture(int32_t id)
 {
     m_CurrentTexture = id;
@@ -428,43 +1761,100 @@ void Renderer::SetStencilState(const bool enabled)
     m_Stencil.SetEnable(enabled);
 }
 
-void Renderer::SetStencilState(const StencilOp operation)
+void Renderer::SetStencilFunc(const StencilFunc func, const uint8_t ref, const uint8_t readMask)
 {
-    m_Stencil.SetOperation(operation);
+    m_Stencil.SetFunc(func, ref, readMask);
 }
 
-void Renderer::SetStencilState(const bool enabled, const StencilOp operation)
+void Renderer::SetStencilOp(const StencilOp stencilFail, const StencilOp depthFail, const StencilOp depthPass)
 {
-    m_Stencil.SetEnable(enabled);
-    m_Stencil.SetOperation(operation);
+    m_Stencil.SetOp(stencilFail, depthFail, depthPass);
 }
 
+void Renderer::SetStencilWriteMask(const uint8_t writeMask)
+{
+    m_Stencil.SetWriteMask(writeMask);
+}
 
-Vector4 Renderer::ApplyTransformationPipeline(const Vertex& vertex)
+void Renderer::SetFragmentPath(const FragmentPath path)
 {
-    const Vector3& position = vertex.m_Position;
+    m_FragmentPath = std::min(path, GetSupportedFragmentPath());
+}
 
-    // Convert to homogenous coords
-    Vector4 coords = Vector4(position, 1.0f);
+FragmentPath Renderer::GetFragmentPath() const
+{
+    return m_FragmentPath;
+}
 
-    // Calculate MVP
-    Matrix4x4 mvp = m_Projection;
-    mvp.Multiply(m_View).Multiply(m_Model);
+void Renderer::SetRenderMode(const RenderMode mode)
+{
+    // Pixels deferred so far are shaded with the state they were drawn with
+    ResolveVisibilityBuffer();
+    m_RenderMode = mode;
+}
 
-    // Apply MVP on coords
-    coords = mvp.Multiply(coords);
+RenderMode Renderer::GetRenderMode() const
+{
+    return m_RenderMode;
+}
+
+ColorFormat Renderer::GetColorFormat() const
+{
+    return m_ColorFormat;
+}
+
+DepthFormat Renderer::GetDepthFormat() const
+{
+    return m_DepthFormat;
+}
+
+FramebufferLayout Renderer::GetLayout() const
+{
+    return m_Layout;
+}
+
+void Renderer::SetCullMode(const CullMode mode)
+{
+    m_CullMode = mode;
+}
+
+CullMode Renderer::GetCullMode() const
+{
+    return m_CullMode;
+}
+
+void Renderer::SetFrontFace(const FrontFace frontFace)
+{
+    m_FrontFace = frontFace;
+}
+
+FrontFace Renderer::GetFrontFace() const
+{
+    return m_FrontFace;
+}
+
+void Renderer::SetSpecializedFragments(const bool enabled)
+{
+    m_SpecializedFragments = enabled;
+}
+
+bool Renderer::GetSpecializedFragments() const
+{
+    return m_SpecializedFragments;
+}
+
+Vector4 Renderer::ClipToScreenCoords(const Vector4& clip) const
+{
+    const float invW = 1.f / clip.w;
 
-    coords.w = 1.f / coords.w;
     // Calculate NDC
-    Vector4 ndc = Vector4(Vector3(coords.x, coords.y, coords.z) * coords.w, coords.w);
+    Vector4 ndc = Vector4(Vector3(clip.x, clip.y, clip.z) * invW, invW);
 
     // Apply viewport
-    Vector4 screenCoords = NdcToScreenCoords(ndc, false);
-
-    return screenCoords;
+    return NdcToScreenCoords(ndc, false);
 }
 
-Vector4 Renderer::NdcToScreenCoords(const Vector4& ndc, const bool ignoreZ)
+Vector4 Renderer::NdcToScreenCoords(const Vector4& ndc, const bool ignoreZ) const
 {
     return Vector4(
         (m_Viewport.width / 2.0f) * (ndc.x + 1) + m_Viewport.x,
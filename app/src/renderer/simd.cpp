@@ -0,0 +1,64 @@
+#include "renderer/simd.h"
+
+#include <stdint.h>
+
+#if defined(RENDERER_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+FragmentPath GetSupportedFragmentPath()
+{
+#if defined(RENDERER_SIMD_X86) && defined(_MSC_VER)
+	int32_t info[4];
+
+	__cpuid(info, 0);
+	const int32_t maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx)
+	{
+		// The OS must save the YMM registers on context switches
+		const bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2)
+		return FragmentPath::AVX2;
+
+	if (sse41)
+		return FragmentPath::SSE4;
+#elif defined(RENDERER_SIMD_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return FragmentPath::AVX2;
+
+	if (__builtin_cpu_supports("sse4.1"))
+		return FragmentPath::SSE4;
+#endif
+
+	return FragmentPath::SCALAR;
+}
+
+const char* GetFragmentPathName(const FragmentPath path)
+{
+	switch (path)
+	{
+		case FragmentPath::SSE4:
+			return "SSE4";
+
+		case FragmentPath::AVX2:
+			return "AVX2";
+
+		default:
+			return "Scalar";
+	}
+}
@@ -1,48 +1,89 @@
 #include "renderer/stencil.h"
 #include "renderer/renderer.h"
 
-Stencil::Stencil(const float width, const float height)
-	: m_Width(width), m_Height(height)
+#include <algorithm>
+
+Stencil::Stencil(const uint32_t nbrPixels)
+	: m_NbrPixels(nbrPixels)
 {
 	m_Enabled = false;
-	m_Operation = StencilOp::WRITE;
 
-	StencilBuffer = new float_t[width * height];
+	m_Func = StencilFunc::ALWAYS;
+	m_Ref = 0;
+	m_ReadMask = 0xff;
+	m_WriteMask = 0xff;
+
+	m_StencilFail = StencilOp::KEEP;
+	m_DepthFail = StencilOp::KEEP;
+	m_DepthPass = StencilOp::KEEP;
+
+	m_Plane.resize(m_NbrPixels, 0);
+	m_Buffer = m_Plane.data();
+	m_Stride = 1;
 }
 
-Stencil::~Stencil()
+void Stencil::SetStorage(uint8_t* const buffer, const uint32_t stride)
 {
-	delete[] StencilBuffer;
+	m_Buffer = buffer;
+	m_Stride = stride;
+
+	m_Plane.clear();
+	m_Plane.shrink_to_fit();
 }
 
-void Stencil::SetOperation(const StencilOp operation)
+void Stencil::Clear()
 {
-	m_Operation = operation;
+	Clear(0, m_NbrPixels);
 }
 
-bool Stencil::ApplyOperation(const uint32_t x, const uint32_t y)
+void Stencil::Clear(const uint32_t offset, const uint32_t count)
 {
-	if (!m_Enabled)
-		return false;
+	if (m_Stride == 1)
+	{
+		std::fill(m_Buffer + offset, m_Buffer + offset + count, 0);
+		return;
+	}
 
-	bool discard = false;
-	uint32_t offset = y * m_Width + x;
+	for (uint32_t i = offset; i < offset + count; i++)
+		m_Buffer[i * m_Stride] = 0;
+}
 
-	switch (m_Operation)
-	{
-		case StencilOp::WRITE:
-			StencilBuffer[offset] = 1.f;
-			break;
+void Stencil::SetFunc(const StencilFunc func, const uint8_t ref, const uint8_t readMask)
+{
+	m_Func = func;
+	m_Ref = ref;
+	m_ReadMask = readMask;
+}
 
-		case StencilOp::DISCARD:
-			if (StencilBuffer[offset] != 0.f)
-				discard = true;
-	}
+void Stencil::SetOp(const StencilOp stencilFail, const StencilOp depthFail, const StencilOp depthPass)
+{
+	m_StencilFail = stencilFail;
+	m_DepthFail = depthFail;
+	m_DepthPass = depthPass;
+}
 
-	return discard;
+void Stencil::SetWriteMask(const uint8_t writeMask)
+{
+	m_WriteMask = writeMask;
 }
 
 void Stencil::SetEnable(const bool enabled)
 {
 	m_Enabled = enabled;
 }
+
+bool Stencil::IsEnabled() const
+{
+	return m_Enabled;
+}
+
+bool Stencil::KeepsHiddenFragments() const
+{
+	return !m_Enabled || m_WriteMask == 0 ||
+		(m_StencilFail == StencilOp::KEEP && m_DepthFail == StencilOp::KEEP);
+}
+
+StencilMode Stencil::GetMode() const
+{
+	return m_Enabled ? StencilMode::TEST : StencilMode::NONE;
+}
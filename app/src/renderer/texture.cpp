@@ -62,38 +62,32 @@ void Texture::SetFiltering(const TexFiltering filtering)
 
 Vector4 Texture::SampleTexel(const Vector2 ntc) const
 {
-	const Vector2 size = Vector2(m_Width, m_Height);
-	Vector2 texCoords = ntc * size;
-
-	texCoords.x = std::clamp(texCoords.x, 0.0f, (float)(m_Width - 1));
-	texCoords.y = std::clamp(texCoords.y, 0.0f, (float)(m_Height - 1));
+	switch (m_Filtering)
+	{
+		case TexFiltering::LINEAR:
+			return SampleTexel<TexFiltering::LINEAR>(ntc);
 
-	return ApplyFiltering(ntc, texCoords);
+		default:
+			return SampleTexel<TexFiltering::NEAREST>(ntc);
+	}
 }
 
-Vector4 Texture::ApplyFiltering(const Vector2 ntc, const Vector2 texCoords) const
+TexFiltering Texture::GetFiltering() const
 {
-	Vector4 result;
-	const Vector2 flooredCoords = Vector2(std::floor(texCoords.x), std::floor(texCoords.y));
-
-	switch (m_Filtering)
-	{
-		case TexFiltering::NEAREST:
-		{
-			const uint32_t offset = flooredCoords.y * m_Width + flooredCoords.x;
-
-			result = m_Data[offset];
-			break;
-		}
+	return m_Filtering;
+}
 
-		case TexFiltering::LINEAR:
-		{
-			const uint32_t offset = flooredCoords.y * m_Width + flooredCoords.x;
+int32_t Texture::GetWidth() const
+{
+	return m_Width;
+}
 
-			result = m_Data[offset];
-			break;
-		}
-	}
+int32_t Texture::GetHeight() const
+{
+	return m_Height;
+}
 
-	return result;
+const Vector4* Texture::GetData() const
+{
+	return m_Data.data();
 }
@@ -0,0 +1,91 @@
+#include "renderer/thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t nbrThreads)
+	: m_Job(nullptr), m_JobSize(0), m_NextIndex(0), m_Generation(0), m_NbrBusy(0), m_Stopping(false)
+{
+	if (nbrThreads == 0)
+		nbrThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (uint32_t i = 1; i < nbrThreads; i++)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+
+	m_WakeUp.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+uint32_t ThreadPool::GetNbrThreads() const
+{
+	return m_Workers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(const uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (m_Workers.empty() || count <= 1)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			job(i);
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Job = &job;
+		m_JobSize = count;
+		m_NextIndex = 0;
+		m_NbrBusy = m_Workers.size();
+		m_Generation++;
+	}
+
+	m_WakeUp.notify_all();
+
+	// The calling thread works as well instead of idling
+	RunJob();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Done.wait(lock, [this]() { return m_NbrBusy == 0; });
+	m_Job = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint32_t generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeUp.wait(lock, [this, generation]() { return m_Stopping || m_Generation != generation; });
+
+			if (m_Stopping)
+				return;
+
+			generation = m_Generation;
+		}
+
+		RunJob();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (--m_NbrBusy == 0)
+			m_Done.notify_one();
+	}
+}
+
+void ThreadPool::RunJob()
+{
+	// Indices are handed out one at a time, so threads that get cheap indices simply take more of them
+	for (uint32_t i = m_NextIndex++; i < m_JobSize; i = m_NextIndex++)
+		(*m_Job)(i);
+}
@@ -0,0 +1,90 @@
+// Vectorized vertex transform, included by the translation units compiled for a given instruction set
+// Lanes wraps the intrinsics of that instruction set, each group of lanes transforms Lanes::Count vertices
+// Like the fragment path, only intrinsics, plain arithmetic and member accesses are used here
+
+template <typename Lanes>
+void Renderer::TransformVerticesSimd(const Matrix4x4& mvp, const Vertex* const vertices, const uint32_t* const list,
+    const uint32_t count, Vector4* const clipPositions, Vector4* const screenPositions) const
+{
+    typedef typename Lanes::Float Float;
+
+    // Rows of the matrix, broadcast to every lane. The positions have w = 1, so the last column is added as is
+    const Vector4* const rows[4] = { &mvp.Row0, &mvp.Row1, &mvp.Row2, &mvp.Row3 };
+    Float matrix[4][4];
+    for (uint32_t r = 0; r < 4; r++)
+    {
+        matrix[r][0] = Lanes::SetFloat(rows[r]->x);
+        matrix[r][1] = Lanes::SetFloat(rows[r]->y);
+        matrix[r][2] = Lanes::SetFloat(rows[r]->z);
+        matrix[r][3] = Lanes::SetFloat(rows[r]->w);
+    }
+
+    const Float one = Lanes::SetFloat(1.f);
+    const Float half = Lanes::SetFloat(.5f);
+    const Float halfWidth = Lanes::SetFloat(m_Viewport.width / 2.0f);
+    const Float halfHeight = Lanes::SetFloat(m_Viewport.height / 2.0f);
+    const Float offsetX = Lanes::SetFloat(static_cast<float>(m_Viewport.x));
+    const Float offsetY = Lanes::SetFloat(static_cast<float>(m_Viewport.y));
+
+    // Positions are gathered from the vertices into one array per component, and the results scattered back
+    constexpr uint32_t width = static_cast<uint32_t>(Lanes::Count);
+    alignas(32) float positions[3][width];
+    alignas(32) float results[8][width];
+
+    for (uint32_t first = 0; first < count; first += width)
+    {
+        // The last group repeats its last vertex in the lanes past the end of the list
+        const uint32_t nbrLanes = count - first < width ? count - first : width;
+        for (uint32_t i = 0; i < width; i++)
+        {
+            const Vector3& position = vertices[list[first + (i < nbrLanes ? i : nbrLanes - 1)]].m_Position;
+
+            positions[0][i] = position.x;
+            positions[1][i] = position.y;
+            positions[2][i] = position.z;
+        }
+
+        const Float x = Lanes::Load(positions[0]);
+        const Float y = Lanes::Load(positions[1]);
+        const Float z = Lanes::Load(positions[2]);
+
+        // Same operations, in the same order, as the scalar path, so that both give the same positions
+        Float clip[4];
+        for (uint32_t r = 0; r < 4; r++)
+        {
+            clip[r] = Lanes::Add(Lanes::Add(Lanes::Add(Lanes::Mul(x, matrix[r][0]), Lanes::Mul(y, matrix[r][1])),
+                Lanes::Mul(z, matrix[r][2])), matrix[r][3]);
+        }
+
+        // Perspective divide and viewport, the screen w keeps 1/w for the perspective correction
+        const Float invW = Lanes::Div(one, clip[3]);
+        const Float screenX = Lanes::Add(Lanes::Mul(halfWidth, Lanes::Add(Lanes::Mul(clip[0], invW), one)), offsetX);
+        const Float screenY = Lanes::Add(Lanes::Mul(halfHeight, Lanes::Add(Lanes::Mul(clip[1], invW), one)), offsetY);
+        const Float screenZ = Lanes::Add(Lanes::Mul(half, Lanes::Mul(clip[2], invW)), half);
+
+        Lanes::Store(results[0], clip[0]);
+        Lanes::Store(results[1], clip[1]);
+        Lanes::Store(results[2], clip[2]);
+        Lanes::Store(results[3], clip[3]);
+        Lanes::Store(results[4], screenX);
+        Lanes::Store(results[5], screenY);
+        Lanes::Store(results[6], screenZ);
+        Lanes::Store(results[7], invW);
+
+        for (uint32_t i = 0; i < nbrLanes; i++)
+        {
+            const uint32_t index = list[first + i];
+            Vector4& clipPosition = clipPositions[index];
+            Vector4& screenPosition = screenPositions[index];
+
+            clipPosition.x = results[0][i];
+            clipPosition.y = results[1][i];
+            clipPosition.z = results[2][i];
+            clipPosition.w = results[3][i];
+            screenPosition.x = results[4][i];
+            screenPosition.y = results[5][i];
+            screenPosition.z = results[6][i];
+            screenPosition.w = results[7][i];
+        }
+    }
+}
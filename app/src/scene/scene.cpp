@@ -1,17 +1,25 @@
 #include "scene/scene.h"
 #include "renderer/material.h"
+
+#ifndef RENDERER_HEADLESS
 #include "ImGui/imgui.h"
+#endif
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 
-Scene::Scene(Renderer& renderer)
+Scene::Scene(Renderer& renderer, const uint32_t nbrInstances)
 {
     m_PeekFramebuffer = false;
     m_HasDrawn = false;
+    m_PickedObject = -1;
+    EnableBvh = true;
+    EnableInstancing = true;
 
     size_t vkRoom = renderer.AddTexture("assets/viking_room.jpg");
 
@@ -72,43 +80,319 @@ Scene::Scene(Renderer& renderer)
             vkRoom)
         );
     }
+
+    // The rooms are large and closed enough to hide what's behind them
+    for (GameObject& go : m_GameObjects)
+        go.Occluder = true;
+
+    CreateInstances(nbrInstances, vkRoom);
+    BuildBvh();
 }
 
 Scene::~Scene()
 {
 }
 
+void Scene::CreateInstances(const uint32_t nbrInstances, const size_t textureId)
+{
+    if (nbrInstances == 0)
+        return;
+
+    // Unit cube, each face with its own vertices for its normal and uvs, counter-clockwise seen from outside
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        const uint32_t axis = face / 2;
+        const float side = face % 2 == 0 ? 1.f : -1.f;
+
+        Vector3 normal = Vector3(0.f);
+        normal[axis] = side;
+
+        Vector3 u = Vector3(0.f);
+        u[(axis + 1) % 3] = 1.f;
+        Vector3 v = Vector3::CrossProduct(normal, u);
+
+        const uint32_t first = static_cast<uint32_t>(vertices.size());
+        const Vector2 corners[4] = { Vector2(0.f, 0.f), Vector2(1.f, 0.f), Vector2(1.f, 1.f), Vector2(0.f, 1.f) };
+        for (const Vector2& corner : corners)
+        {
+            const Vector3 position = normal * .5f + u * (corner.x - .5f) + v * (corner.y - .5f);
+            vertices.push_back(Vertex(position, Vector4(1.0f), normal, corner));
+        }
+
+        const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (const uint32_t corner : quad)
+            indices.push_back(first + corner);
+    }
+
+    GameObject cube = GameObject(Vector3(0.f), Vector3(0.f), Vector3(.5f));
+    cube.CreateMesh("cube", vertices, indices);
+    cube.TextureId = textureId;
+
+    // Square grid centered under the models, the copies share the mesh of the cube
+    const uint32_t nbrColumns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(nbrInstances))));
+    const float offset = (nbrColumns - 1) * INSTANCE_SPACING * .5f;
+
+    m_GameObjects.reserve(m_GameObjects.size() + nbrInstances);
+    for (uint32_t i = 0; i < nbrInstances; i++)
+    {
+        cube.Position = Vector3((i % nbrColumns) * INSTANCE_SPACING - offset, 1.5f, (i / nbrColumns) * INSTANCE_SPACING - offset);
+        cube.Rotation = Vector3(0.f, (i * 2654435761u % 360) * static_cast<float>(M_PI) / 180.f, 0.f);
+        m_GameObjects.push_back(cube);
+    }
+
+    std::cout << "Benchmark scene : " << nbrInstances << " cubes" << std::endl;
+}
+
+void Scene::BuildBvh()
+{
+    const uint32_t nbrObjects = static_cast<uint32_t>(m_GameObjects.size());
+
+    std::vector<Vector3> mins = std::vector<Vector3>(nbrObjects);
+    std::vector<Vector3> maxs = std::vector<Vector3>(nbrObjects);
+    m_BvhTransforms.resize(nbrObjects);
+
+    for (uint32_t i = 0; i < nbrObjects; i++)
+    {
+        const GameObject& go = m_GameObjects[i];
+        go.CalculateWorldBounds(mins[i], maxs[i]);
+        m_BvhTransforms[i] = { go.Position, go.Rotation, go.Scaling, go.Outlined };
+    }
+
+    m_Bvh.Build(mins, maxs);
+}
+
+static bool IsSameVector(const Vector3& a, const Vector3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+void Scene::UpdateBvh()
+{
+    // The objects are edited in place, so their transforms are compared with the ones of their leaves
+    for (uint32_t i = 0; i < m_GameObjects.size(); i++)
+    {
+        const GameObject& go = m_GameObjects[i];
+        ObjectTransform& transform = m_BvhTransforms[i];
+
+        if (IsSameVector(go.Position, transform.Position) && IsSameVector(go.Rotation, transform.Rotation) &&
+            IsSameVector(go.Scaling, transform.Scaling) && go.Outlined == transform.Outlined)
+            continue;
+
+        transform = { go.Position, go.Rotation, go.Scaling, go.Outlined };
+
+        Vector3 min;
+        Vector3 max;
+        go.CalculateWorldBounds(min, max);
+        m_Bvh.Update(i, min, max);
+    }
+}
+
+void Scene::FindVisibleObjects(Renderer& renderer)
+{
+    m_VisibleObjects.clear();
+
+    const uint32_t nbrObjects = static_cast<uint32_t>(m_GameObjects.size());
+    const uint32_t nbrShown = static_cast<uint32_t>(std::count_if(m_GameObjects.begin(), m_GameObjects.end(),
+        [](const GameObject& go) { return !go.Hidden; }));
+
+    if (!renderer.EnableFrustumCulling)
+    {
+        for (uint32_t i = 0; i < nbrObjects; i++)
+        {
+            if (!m_GameObjects[i].Hidden)
+                m_VisibleObjects.push_back(i);
+        }
+
+        return;
+    }
+
+    if (EnableBvh)
+    {
+        UpdateBvh();
+
+        m_IntersectingObjects.clear();
+        m_Bvh.QueryFrustum(renderer.Camera.GetFrustum(), m_VisibleObjects, m_IntersectingObjects);
+
+        // The boxes of the leaves are loose, so the objects crossing a plane are tested with their own bounds
+        for (const uint32_t i : m_IntersectingObjects)
+        {
+            if (m_GameObjects[i].IsVisible(renderer))
+                m_VisibleObjects.push_back(i);
+        }
+
+        m_VisibleObjects.erase(std::remove_if(m_VisibleObjects.begin(), m_VisibleObjects.end(),
+            [this](const uint32_t i) { return m_GameObjects[i].Hidden; }), m_VisibleObjects.end());
+
+        // Drawn in the same order as without culling, blending and stencil depend on it
+        std::sort(m_VisibleObjects.begin(), m_VisibleObjects.end());
+    }
+    else
+    {
+        for (uint32_t i = 0; i < nbrObjects; i++)
+        {
+            const GameObject& go = m_GameObjects[i];
+            if (!go.Hidden && go.IsVisible(renderer))
+                m_VisibleObjects.push_back(i);
+        }
+    }
+
+    renderer.NbrObjectsCulled = nbrShown - static_cast<uint32_t>(m_VisibleObjects.size());
+}
+
+void Scene::CullOccludedObjects(Renderer& renderer)
+{
+    for (const uint32_t i : m_VisibleObjects)
+    {
+        if (m_GameObjects[i].Occluder)
+            m_GameObjects[i].RenderOccluder(renderer);
+    }
+
+    // Occluders are always drawn, they can't hide themselves and rarely hide each other
+    const size_t nbrVisible = m_VisibleObjects.size();
+    m_VisibleObjects.erase(std::remove_if(m_VisibleObjects.begin(), m_VisibleObjects.end(),
+        [this, &renderer](const uint32_t i)
+        {
+            const GameObject& go = m_GameObjects[i];
+            if (go.Occluder)
+                return false;
+
+            renderer.NbrObjectsOcclusionTested++;
+            return go.IsOccluded(renderer);
+        }), m_VisibleObjects.end());
+
+    renderer.NbrObjectsOccluded = static_cast<uint32_t>(nbrVisible - m_VisibleObjects.size());
+}
+
+int32_t Scene::Pick(const Renderer& renderer, const float x, const float y)
+{
+    Vector3 origin;
+    Vector3 direction;
+    renderer.Camera.ScreenToRay(x, y, origin, direction);
+
+    // The boxes hit are visited from the closest, until they're further than the closest object hit
+    UpdateBvh();
+    m_Bvh.QueryRay(origin, direction, m_RayHits);
+
+    int32_t picked = -1;
+    float closest = INFINITY;
+    for (const auto& [entry, object] : m_RayHits)
+    {
+        if (entry >= closest)
+            break;
+
+        const GameObject& go = m_GameObjects[object];
+
+        float distance;
+        if (!go.Hidden && go.Raycast(origin, direction, distance) && distance < closest)
+        {
+            closest = distance;
+            picked = static_cast<int32_t>(object);
+        }
+    }
+
+    if (m_PickedObject >= 0)
+        m_GameObjects[m_PickedObject].Outlined = false;
+
+    m_PickedObject = picked;
+    if (m_PickedObject >= 0)
+        m_GameObjects[m_PickedObject].Outlined = true;
+
+    return picked;
+}
+
+uint32_t Scene::GetNbrObjects() const
+{
+    return static_cast<uint32_t>(m_GameObjects.size());
+}
+
+const Bvh& Scene::GetBvh() const
+{
+    return m_Bvh;
+}
+
 void Scene::Update(const float deltaTime, Renderer& renderer)
 {
+#ifndef RENDERER_HEADLESS
+    Vector2 click;
+    if (renderer.GetViewportClick(click))
+        Pick(renderer, click.x, click.y);
+
     ShowImGuiControls(renderer);
+#endif
 
     if (!m_HasDrawn)
     {
         using std::chrono::high_resolution_clock;
 
-        std::chrono::steady_clock::time_point t1 = high_resolution_clock::now();
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
         // m_HasDrawn = true;
-        renderer.ClearBuffers();
+        Render(renderer);
+        renderer.PresentFrame();
 
-        for (uint32_t i = 0; i < m_GameObjects.size(); i++)
-        {
-            const GameObject& go = m_GameObjects[i];
-            if (go.Outlined)
-                go.RenderOutlined(renderer);
-            else
-                go.Render(renderer);
-        }
-
-        std::chrono::steady_clock::time_point t2 = high_resolution_clock::now();
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
 
         std::chrono::duration<double, std::milli> ms_double = t2 - t1;
         // std::cout << "Rendering time : " << ms_double << std::endl;
     }
 
+#ifndef RENDERER_HEADLESS
     renderer.ForwardToImgui();
+#endif
 }
 
+void Scene::Render(Renderer& renderer)
+{
+    renderer.ClearBuffers();
+
+    using std::chrono::high_resolution_clock;
+
+    const high_resolution_clock::time_point start = high_resolution_clock::now();
+    FindVisibleObjects(renderer);
+    renderer.CullingTime = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - start).count();
+
+    if (renderer.EnableOcclusionCulling)
+    {
+        const high_resolution_clock::time_point occlusionStart = high_resolution_clock::now();
+        CullOccludedObjects(renderer);
+        renderer.OcclusionTime = std::chrono::duration<double, std::milli>(high_resolution_clock::now() - occlusionStart).count();
+    }
+
+    for (size_t i = 0; i < m_VisibleObjects.size();)
+    {
+        const GameObject& go = m_GameObjects[m_VisibleObjects[i]];
+
+        // Consecutive objects sharing their mesh, texture and material are drawn together
+        size_t end = i + 1;
+        while (EnableInstancing && end < m_VisibleObjects.size() && m_GameObjects[m_VisibleObjects[end]].CanShareDraw(go))
+            end++;
+
+        if (end - i > 1)
+        {
+            m_InstancedObjects.clear();
+            for (size_t j = i; j < end; j++)
+                m_InstancedObjects.push_back(&m_GameObjects[m_VisibleObjects[j]]);
+
+            GameObject::RenderInstanced(renderer, m_InstancedObjects);
+        }
+        else if (go.Outlined)
+        {
+            go.RenderOutlined(renderer);
+        }
+        else
+        {
+            go.Render(renderer);
+        }
+
+        i = end;
+    }
+
+    renderer.ResolveVisibilityBuffer();
+}
+
+#ifndef RENDERER_HEADLESS
 void Scene::SetImGuiContext(struct ImGuiContext* context)
 {
 }
@@ -126,13 +410,60 @@ void Scene::Ui_Controls(Renderer& renderer)
     if (ImGui::Begin("Controls"))
     {
         ImGui::Text("FPS : %f", 1.f / ImGui::GetIO().DeltaTime);
+        ImGui::Text("Nbr objects culled : %d", renderer.NbrObjectsCulled);
+        ImGui::Text("Clear time : %f ms (%f ms filling the untouched tiles)", renderer.ClearTime, renderer.ClearResolveTime);
+        ImGui::Text("Present time : %f ms (%f ms converting on the present thread, %d color targets)",
+            renderer.PresentTime, renderer.ConvertTime, renderer.GetNbrColorTargets());
+        ImGui::Text("Culling time : %f ms", renderer.CullingTime);
+        ImGui::Text("Nbr objects occluded : %d / %d", renderer.NbrObjectsOccluded, renderer.NbrObjectsOcclusionTested);
+        ImGui::Text("Occlusion time : %f ms", renderer.OcclusionTime);
+        ImGui::Text("Nbr draws : %d", renderer.NbrDraws);
+        ImGui::Text("Nbr vertices transformed : %d", renderer.NbrVerticesTransformed);
+        ImGui::Text("Vertex transform time : %f ms", renderer.TransformTime);
         ImGui::Text("Nbr triangles rendered : %d", renderer.NbrTrianglesRendered);
+        ImGui::Text("Nbr triangles culled : %d", renderer.NbrTrianglesCulled);
+        ImGui::Text("Nbr triangles clipped : %d", renderer.NbrTrianglesClipped);
+        ImGui::Text("Nbr triangles culled by facing : %d", renderer.NbrTrianglesCulledByFacing);
+        ImGui::Text("Nbr pixels tested : %llu", renderer.NbrPixelsTested);
+        ImGui::Text("Nbr pixels shaded : %llu", renderer.NbrPixelsShaded);
+        ImGui::Text("Nbr tiles rejected by depth : %d", renderer.NbrTilesRejected);
+        ImGui::Text("Nbr blocks rejected by depth : %d", renderer.NbrBlocksRejected);
+        ImGui::Text("Framebuffer : %s color, %s depth, %s layout", GetColorFormatName(renderer.GetColorFormat()),
+            GetDepthFormatName(renderer.GetDepthFormat()), GetFramebufferLayoutName(renderer.GetLayout()));
         if (ImGui::Button("Re-render"))
             m_HasDrawn = false;
 
         ImGui::SliderFloat3("Camera position", &renderer.Camera.Position.x, -2.f, 10.f);
         ImGui::SliderFloat3("Camera center", &renderer.Camera.Center.x, -2.f, 2.f);
-        ImGui::Checkbox("Backface culling", &renderer.EnableBackfaceCulling);
+        const char* const cullModes[] = { "None", "Back", "Front" };
+        int32_t cullMode = static_cast<int32_t>(renderer.GetCullMode());
+        if (ImGui::Combo("Cull mode", &cullMode, cullModes, IM_ARRAYSIZE(cullModes)))
+            renderer.SetCullMode(static_cast<CullMode>(cullMode));
+
+        const char* const frontFaces[] = { "Clockwise", "Counter-clockwise" };
+        int32_t frontFace = static_cast<int32_t>(renderer.GetFrontFace());
+        if (ImGui::Combo("Front face", &frontFace, frontFaces, IM_ARRAYSIZE(frontFaces)))
+            renderer.SetFrontFace(static_cast<FrontFace>(frontFace));
+
+        ImGui::Checkbox("Level of detail", &renderer.EnableLod);
+        ImGui::Checkbox("Frustum culling", &renderer.EnableFrustumCulling);
+        ImGui::Checkbox("Bounding volume hierarchy", &EnableBvh);
+        ImGui::Checkbox("Instancing", &EnableInstancing);
+        ImGui::Checkbox("Occlusion culling", &renderer.EnableOcclusionCulling);
+
+        const char* const fragmentPaths[] = { "Scalar", "SSE4", "AVX2" };
+        int32_t fragmentPath = static_cast<int32_t>(renderer.GetFragmentPath());
+        if (ImGui::Combo("Fragment path", &fragmentPath, fragmentPaths, IM_ARRAYSIZE(fragmentPaths)))
+            renderer.SetFragmentPath(static_cast<FragmentPath>(fragmentPath));
+
+        const char* const renderModes[] = { "Forward", "Deferred" };
+        int32_t renderMode = static_cast<int32_t>(renderer.GetRenderMode());
+        if (ImGui::Combo("Render mode", &renderMode, renderModes, IM_ARRAYSIZE(renderModes)))
+            renderer.SetRenderMode(static_cast<RenderMode>(renderMode));
+
+        bool specializedFragments = renderer.GetSpecializedFragments();
+        if (ImGui::Checkbox("Specialized fragments", &specializedFragments))
+            renderer.SetSpecializedFragments(specializedFragments);
 
         ImGui::SliderAngle("FOV", &renderer.Camera.Fov, 10.f, 90.f);
 
@@ -146,29 +477,42 @@ void Scene::Ui_GameObjects(Renderer& renderer)
 {
     if (ImGui::Begin("Gameobjects"))
     {
-        for (uint32_t i = 0; i < m_GameObjects.size(); i++)
+        ImGui::Text("Picked : %d (click the framebuffer to pick)", m_PickedObject);
+
+        if (m_GameObjects.size() <= MAX_LISTED_OBJECTS)
         {
-            GameObject& go = m_GameObjects[i];
+            for (uint32_t i = 0; i < m_GameObjects.size(); i++)
+                Ui_GameObject(i);
+        }
+        else if (m_PickedObject >= 0)
+        {
+            Ui_GameObject(m_PickedObject);
+        }
+    }
 
-            ImGui::PushID(i);
+    ImGui::End();
+}
 
-            ImGui::Separator();
-            ImGui::Text("ID : %d", i);
+void Scene::Ui_GameObject(const uint32_t index)
+{
+    GameObject& go = m_GameObjects[index];
 
-            ImGui::Checkbox("Hidden", &go.Hidden);
-            ImGui::Checkbox("Outlined", &go.Outlined);
+    ImGui::PushID(index);
 
-            ImGui::SliderFloat3("Position", &go.Position.x, -5.f, 5.f);
-            ImGui::SliderAngle("Rotation X", &go.Rotation.x, -360.f, 360.f);
-            ImGui::SliderAngle("Rotation Y", &go.Rotation.y, -360.f, 360.f);
-            ImGui::SliderAngle("Rotation Z", &go.Rotation.z, -360.f, 360.f);
-            ImGui::SliderFloat3("Scaling", &go.Scaling.x, -3.f, 3.f);
+    ImGui::Separator();
+    ImGui::Text("ID : %d", index);
 
-            ImGui::PopID();
-        }
-    }
+    ImGui::Checkbox("Hidden", &go.Hidden);
+    ImGui::Checkbox("Outlined", &go.Outlined);
+    ImGui::Checkbox("Occluder", &go.Occluder);
 
-    ImGui::End();
+    ImGui::SliderFloat3("Position", &go.Position.x, -5.f, 5.f);
+    ImGui::SliderAngle("Rotation X", &go.Rotation.x, -360.f, 360.f);
+    ImGui::SliderAngle("Rotation Y", &go.Rotation.y, -360.f, 360.f);
+    ImGui::SliderAngle("Rotation Z", &go.Rotation.z, -360.f, 360.f);
+    ImGui::SliderFloat3("Scaling", &go.Scaling.x, -3.f, 3.f);
+
+    ImGui::PopID();
 }
 
 void Scene::Ui_Framebuffer(Renderer& renderer)
@@ -237,3 +581,4 @@ void Scene::Ui_Lights(Renderer& renderer)
 
     ImGui::End();
 }
+#endif